@@ -3,155 +3,2536 @@
 #include <vector>
 #include <filesystem>
 #include "../sqlite3/sqlite3.h"
-#include <thread>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <wininet.h>
-#include <sstream>
 #include "../API/RainmeterAPI.h"
-#include <set>
+#include <string_view>
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <functional>
+#include <deque>
+#include <unordered_map>
+#include <random>
+#include <iterator>
+#include <cstdarg>
 #pragma comment(lib, "wininet.lib")
 
-std::wstring Utf8ToWide(const std::string& utf8Str) {
-    if (utf8Str.empty()) {
-        return std::wstring();
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MSB_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define MSB_USE_AVX2 1
+#include <immintrin.h>
+#endif
+
+/*
+* UTF-8 Transcoding
+*/
+
+// Decodes one non-ASCII sequence at p, writing one or two UTF-16 units.
+// Invalid input becomes U+FFFD per maximal subpart, matching MultiByteToWideChar.
+inline void DecodeUtf8Sequence(const unsigned char*& p, const unsigned char* end, char16_t*& out) {
+    const unsigned char lead = *p;
+    const size_t available = static_cast<size_t>(end - p);
+
+    if (lead >= 0xC2 && lead < 0xE0) {
+        if (available >= 2 && (p[1] & 0xC0) == 0x80) {
+            *out++ = static_cast<char16_t>(((lead & 0x1F) << 6) | (p[1] & 0x3F));
+            p += 2;
+            return;
+        }
+    }
+    else if (lead >= 0xE0 && lead < 0xF0) {
+        unsigned char low = lead == 0xE0 ? 0xA0 : 0x80;
+        unsigned char high = lead == 0xED ? 0x9F : 0xBF;
+        if (available >= 2 && p[1] >= low && p[1] <= high) {
+            if (available >= 3 && (p[2] & 0xC0) == 0x80) {
+                *out++ = static_cast<char16_t>(((lead & 0x0F) << 12) | ((p[1] & 0x3F) << 6) | (p[2] & 0x3F));
+                p += 3;
+                return;
+            }
+            *out++ = 0xFFFD;
+            p += 2;
+            return;
+        }
+    }
+    else if (lead >= 0xF0 && lead < 0xF5) {
+        unsigned char low = lead == 0xF0 ? 0x90 : 0x80;
+        unsigned char high = lead == 0xF4 ? 0x8F : 0xBF;
+        if (available >= 2 && p[1] >= low && p[1] <= high) {
+            if (available >= 3 && (p[2] & 0xC0) == 0x80) {
+                if (available >= 4 && (p[3] & 0xC0) == 0x80) {
+                    uint32_t codePoint = ((lead & 0x07) << 18) | ((p[1] & 0x3F) << 12) | ((p[2] & 0x3F) << 6) | (p[3] & 0x3F);
+                    codePoint -= 0x10000;
+                    *out++ = static_cast<char16_t>(0xD800 | (codePoint >> 10));
+                    *out++ = static_cast<char16_t>(0xDC00 | (codePoint & 0x3FF));
+                    p += 4;
+                    return;
+                }
+                *out++ = 0xFFFD;
+                p += 3;
+                return;
+            }
+            *out++ = 0xFFFD;
+            p += 2;
+            return;
+        }
+    }
+
+    *out++ = 0xFFFD;
+    p += 1;
+}
+
+// Converts UTF-8 into a caller-provided buffer and returns the number of UTF-16 units written.
+// The output never needs more units than the input has bytes. Runs of ASCII are widened
+// 32 or 16 bytes at a time with AVX2/SSE2; everything else goes through the validating decoder.
+size_t Utf8ToUtf16(const char* src, size_t length, char16_t* dst) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(src);
+    const unsigned char* end = p + length;
+    char16_t* out = dst;
+
+    while (p < end) {
+#if MSB_USE_AVX2
+        while (end - p >= 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            if (_mm256_movemask_epi8(chunk) != 0) {
+                break;
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_cvtepu8_epi16(_mm256_castsi256_si128(chunk)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 16), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(chunk, 1)));
+            p += 32;
+            out += 32;
+        }
+#endif
+#if MSB_USE_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        while (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            if (_mm_movemask_epi8(chunk) != 0) {
+                break;
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(chunk, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpackhi_epi8(chunk, zero));
+            p += 16;
+            out += 16;
+        }
+#endif
+
+        // Decode at least one block on the scalar path before trying the vector path again,
+        // so non-Latin text does not pay for a failed vector probe on every character
+        const unsigned char* scalarEnd = end - p > 16 ? p + 16 : end;
+        while (p < scalarEnd) {
+            if (*p < 0x80) {
+                *out++ = *p++;
+            }
+            else {
+                DecodeUtf8Sequence(p, end, out);
+            }
+        }
+    }
+
+    return static_cast<size_t>(out - dst);
+}
+
+/*
+* Title Storage
+*/
+
+// All titles of one result set as compact UTF-8 in a single NUL-separated buffer plus an
+// offset table. Once frozen into a snapshot, a title is only transcoded to UTF-16 the first
+// time GetWide() asks for it. That copy is installed with a compare-and-swap, so concurrent
+// readers never lock, and it lives as long as the store.
+class TitleStore {
+public:
+    TitleStore() : offsets(1, 0), wideCount(0) {}
+    ~TitleStore() { ReleaseWide(); }
+
+    // Moves leave the source as a valid empty store; copies are not allowed
+    TitleStore(TitleStore&& other) noexcept : offsets(1, 0), wideCount(0) { Swap(other); }
+    TitleStore& operator=(TitleStore&& other) noexcept {
+        Swap(other);
+        other.Clear();
+        return *this;
+    }
+    TitleStore(const TitleStore&) = delete;
+    TitleStore& operator=(const TitleStore&) = delete;
+
+    size_t Size() const { return offsets.size() - 1; }
+    bool Empty() const { return offsets.size() == 1; }
+
+    std::string_view View(size_t index) const {
+        return std::string_view(bytes.data() + offsets[index], offsets[index + 1] - offsets[index] - 1);
+    }
+
+    // Only valid after Freeze()
+    const wchar_t* GetWide(size_t index) const {
+        static_assert(sizeof(wchar_t) == sizeof(char16_t), "wchar_t must be a UTF-16 code unit");
+
+        std::atomic<wchar_t*>& slot = wideTitles[index];
+        wchar_t* wideTitle = slot.load(std::memory_order_acquire);
+        if (wideTitle) {
+            return wideTitle;
+        }
+
+        std::string_view utf8Title = View(index);
+        wchar_t* converted = new wchar_t[utf8Title.size() + 1];
+        size_t length = Utf8ToUtf16(utf8Title.data(), utf8Title.size(), reinterpret_cast<char16_t*>(converted));
+        converted[length] = L'\0';
+
+        // Another reader may have converted the same title first; keep theirs
+        if (!slot.compare_exchange_strong(wideTitle, converted, std::memory_order_acq_rel)) {
+            delete[] converted;
+            return wideTitle;
+        }
+        return converted;
+    }
+
+    void Append(std::string_view utf8Title) {
+        bytes.append(utf8Title.data(), utf8Title.size());
+        bytes.push_back('\0');
+        offsets.push_back(static_cast<uint32_t>(bytes.size()));
+    }
+
+    void Reserve(size_t titleCount, size_t byteCount) {
+        offsets.reserve(titleCount + 1);
+        bytes.reserve(byteCount);
+    }
+
+    size_t ByteCount() const { return bytes.size(); }
+
+    // Allocates the per-title UTF-16 cache; no titles may be appended afterwards
+    void Freeze() {
+        ReleaseWide();
+        wideCount = Size();
+        wideTitles.reset(new std::atomic<wchar_t*>[wideCount]);
+        for (size_t i = 0; i < wideCount; ++i) {
+            wideTitles[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    void Clear() {
+        bytes.clear();
+        offsets.assign(1, 0);
+        ReleaseWide();
+    }
+
+    void Swap(TitleStore& other) noexcept {
+        bytes.swap(other.bytes);
+        offsets.swap(other.offsets);
+        wideTitles.swap(other.wideTitles);
+        std::swap(wideCount, other.wideCount);
+    }
+
+private:
+    void ReleaseWide() {
+        for (size_t i = 0; i < wideCount; ++i) {
+            delete[] wideTitles[i].load(std::memory_order_relaxed);
+        }
+        wideTitles.reset();
+        wideCount = 0;
+    }
+
+    std::string bytes;
+    std::vector<uint32_t> offsets;  // Start of each title, plus the end of the buffer
+    std::unique_ptr<std::atomic<wchar_t*>[]> wideTitles;
+    size_t wideCount;
+};
+
+uint64_t HashBytes(const void* data, size_t length);
+
+// Immutable result set published by a load. Workers replace the parent's pointer with
+// std::atomic_store and readers pin the current one with std::atomic_load, so a reader
+// never waits for a load and a snapshot stays valid for as long as someone holds it.
+// The hashes tell consumers whether a new snapshot actually differs from one they saw.
+struct ResultSnapshot {
+    const uint64_t version;
+    const TitleStore titles;
+    const std::vector<uint64_t> itemHashes;  // Hash of each title's UTF-8 bytes
+    const uint64_t contentHash;              // Hash of itemHashes, covering titles and order
+
+    ResultSnapshot(uint64_t snapshotVersion, TitleStore&& snapshotTitles)
+        : version(snapshotVersion), titles(Frozen(std::move(snapshotTitles))), itemHashes(HashItems(titles)),
+          contentHash(HashBytes(itemHashes.data(), itemHashes.size() * sizeof(uint64_t))) {}
+
+private:
+    static TitleStore Frozen(TitleStore&& titles) {
+        titles.Freeze();
+        return std::move(titles);
+    }
+
+    static std::vector<uint64_t> HashItems(const TitleStore& titles) {
+        std::vector<uint64_t> hashes(titles.Size());
+        for (size_t i = 0; i < titles.Size(); ++i) {
+            std::string_view title = titles.View(i);
+            hashes[i] = HashBytes(title.data(), title.size());
+        }
+        return hashes;
+    }
+};
+
+std::string WideToUtf8(const std::wstring& wideStr) {
+    if (wideStr.empty()) {
+        return std::string();
+    }
+
+    int utf8StrLen = WideCharToMultiByte(CP_UTF8, 0, wideStr.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    if (utf8StrLen == 0) {
+        return std::string();
+    }
+
+    std::string utf8Str(utf8StrLen - 1, 0);
+    WideCharToMultiByte(CP_UTF8, 0, wideStr.c_str(), -1, &utf8Str[0], utf8StrLen, nullptr, nullptr);
+    return utf8Str;
+}
+
+/*
+* Title Deduplication
+*/
+
+uint64_t HashBytes(const void* data, size_t length) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = 0xCBF29CE484222325ULL ^ length;
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001B3ULL;
+        hash ^= hash >> 29;
+    }
+    for (; i < length; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    }
+
+    // Final avalanche so the low bits used for slot selection are well mixed
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Open-addressing string set keyed by a 64-bit hash. Keys are copied into one arena and
+// compared on every hash match, so a collision can never merge two distinct titles.
+template <typename CharT>
+class FlatStringSet {
+public:
+    typedef std::basic_string_view<CharT> View;
+
+    explicit FlatStringSet(size_t expectedCount = 0) : count(0) {
+        size_t capacity = 16;
+        while (capacity < expectedCount * 2) {
+            capacity *= 2;
+        }
+        slots.resize(capacity);
+    }
+
+    // Returns false if the key was already present
+    bool Insert(View key) {
+        uint64_t hash = HashBytes(key.data(), key.size() * sizeof(CharT));
+        Slot* slot = Find(key, hash);
+        if (slot->offset != kEmpty) {
+            return false;
+        }
+
+        slot->hash = hash;
+        slot->offset = arena.size();
+        slot->length = key.size();
+        arena.append(key.data(), key.size());
+
+        if (++count * 2 > slots.size()) {
+            Grow();
+        }
+        return true;
+    }
+
+    bool Contains(View key) const {
+        uint64_t hash = HashBytes(key.data(), key.size() * sizeof(CharT));
+        return const_cast<FlatStringSet*>(this)->Find(key, hash)->offset != kEmpty;
+    }
+
+private:
+    static const size_t kEmpty = SIZE_MAX;
+
+    struct Slot {
+        uint64_t hash;
+        size_t offset;
+        size_t length;
+
+        Slot() : hash(0), offset(kEmpty), length(0) {}
+    };
+
+    // Linear probing; returns the matching slot or the empty slot where the key belongs
+    Slot* Find(View key, uint64_t hash) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.offset == kEmpty ||
+                (slot.hash == hash && View(arena.data() + slot.offset, slot.length) == key)) {
+                return &slot;
+            }
+        }
+    }
+
+    void Grow() {
+        std::vector<Slot> oldSlots(slots.size() * 2);
+        oldSlots.swap(slots);
+
+        size_t mask = slots.size() - 1;
+        for (const Slot& slot : oldSlots) {
+            if (slot.offset == kEmpty) {
+                continue;
+            }
+            size_t i = static_cast<size_t>(slot.hash) & mask;
+            while (slots[i].offset != kEmpty) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+    }
+
+    std::vector<Slot> slots;
+    std::basic_string<CharT> arena;
+    size_t count;
+};
+
+/*
+* Load Cancellation
+*/
+
+// Shared by one load and the parent that started it. Cancel() never waits; the load
+// notices at its next checkpoint and returns without publishing anything.
+class LoadToken {
+public:
+    explicit LoadToken(uint64_t loadGeneration) : generation(loadGeneration), cancelled(false) {}
+
+    bool IsCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+    void Cancel() { cancelled.store(true, std::memory_order_relaxed); }
+
+    const uint64_t generation;
+
+private:
+    std::atomic<bool> cancelled;
+};
+
+// sqlite3_progress_handler callback; a non-zero return interrupts the running statement
+int CancelProgressHandler(void* token) {
+    return static_cast<const LoadToken*>(token)->IsCancelled() ? 1 : 0;
+}
+
+// Log lines of one load. Workers never touch a measure's rm, since the measure may be
+// finalized while its load still runs; the lines are replayed on the skin thread instead.
+class LoadLog {
+public:
+    void Add(int level, LPCWSTR format, ...) {
+        wchar_t buffer[512];
+        va_list args;
+        va_start(args, format);
+        vswprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), format, args);
+        va_end(args);
+        lines.emplace_back(level, buffer);
+    }
+
+    // Skin thread only, with the rm of a live measure
+    void Replay(void* rm) const {
+        for (const auto& line : lines) {
+            RmLog(rm, line.first, line.second.c_str());
+        }
+    }
+
+private:
+    std::vector<std::pair<int, std::wstring>> lines;
+};
+
+/*
+* Read Chrome DB File
+*/
+
+std::wstring GetChromeHistoryPath(const std::wstring& profile) {
+    std::wstring chromeHistorySource = L"%LOCALAPPDATA%\\Google\\Chrome\\User Data\\" + profile + L"\\History";
+
+    wchar_t resolvedPath[MAX_PATH];
+    ExpandEnvironmentStringsW(chromeHistorySource.c_str(), resolvedPath, MAX_PATH);
+    return resolvedPath;
+}
+
+HANDLE OpenSharedFile(const std::wstring& path) {
+    // Share everything with the writer (Chrome) so the file is never blocked
+    return CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+}
+
+uint64_t GetOpenFileSize(HANDLE file) {
+    LARGE_INTEGER fileSize;
+    return GetFileSizeEx(file, &fileSize) ? static_cast<uint64_t>(fileSize.QuadPart) : 0;
+}
+
+// Reads up to length bytes at offset and returns how many were read
+size_t ReadFileAt(HANDLE file, uint64_t offset, void* buffer, size_t length) {
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(offset);
+    if (!SetFilePointerEx(file, position, nullptr, FILE_BEGIN)) {
+        return 0;
+    }
+
+    size_t total = 0;
+    while (total < length) {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(length - total, 1 << 20));
+        DWORD bytesRead = 0;
+        if (!ReadFile(file, static_cast<unsigned char*>(buffer) + total, chunk, &bytesRead, nullptr) || bytesRead == 0) {
+            break;
+        }
+        total += bytesRead;
+    }
+    return total;
+}
+
+/*
+* In-Memory History VFS
+*/
+
+// Raw History bytes owned by a parent and served read-only to SQLite by the memory VFS.
+// The page checksums and WAL position let later refreshes rewrite only what changed.
+struct HistoryImage {
+    std::vector<unsigned char> data;
+
+    uint64_t mainFileSize;
+    uint32_t pageSize;
+    std::vector<uint64_t> pageChecksums;  // Main file pages as last read, before WAL frames
+    std::vector<uint32_t> walPages;       // Pages currently holding WAL content instead of main file content
+
+    bool walBigEndian;
+    uint32_t walSalt1;
+    uint32_t walSalt2;
+    uint32_t walChecksum0;
+    uint32_t walChecksum1;
+    uint64_t walOffset;  // End of the last applied commit frame, 0 when no WAL has been read
+
+    HistoryImage() : mainFileSize(0), pageSize(0), walBigEndian(false), walSalt1(0), walSalt2(0),
+                     walChecksum0(0), walChecksum1(0), walOffset(0) {}
+};
+
+// I/O done by one image refresh
+struct HistoryRefreshStats {
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+
+    HistoryRefreshStats() : bytesRead(0), bytesWritten(0) {}
+};
+
+const char* const kMemoryVfsName = "msb-memory";
+const char* const kMemoryFilePrefix = "msb-history-";
+
+inline uint32_t ReadBigEndian32(const unsigned char* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+inline uint32_t ReadLittleEndian32(const unsigned char* p) {
+    return (static_cast<uint32_t>(p[3]) << 24) | (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[1]) << 8) | static_cast<uint32_t>(p[0]);
+}
+
+// Cumulative WAL checksum as defined by the SQLite file format
+void WalChecksum(bool bigEndian, const unsigned char* data, size_t length, uint32_t& s0, uint32_t& s1) {
+    for (size_t i = 0; i + 8 <= length; i += 8) {
+        uint32_t x0 = bigEndian ? ReadBigEndian32(data + i) : ReadLittleEndian32(data + i);
+        uint32_t x1 = bigEndian ? ReadBigEndian32(data + i + 4) : ReadLittleEndian32(data + i + 4);
+        s0 += x0 + s1;
+        s1 += x1 + s0;
+    }
+}
+
+// Starts applying a WAL from its 32-byte header; returns false if the header is not valid
+bool BeginWal(HistoryImage& image, const unsigned char* header) {
+    uint32_t magic = ReadBigEndian32(header);
+    if ((magic & 0xFFFFFFFE) != 0x377F0682 || ReadBigEndian32(header + 8) != image.pageSize) {
+        return false;
+    }
+
+    bool bigEndian = (magic & 1) != 0;
+    uint32_t s0 = 0, s1 = 0;
+    WalChecksum(bigEndian, header, 24, s0, s1);
+    if (s0 != ReadBigEndian32(header + 24) || s1 != ReadBigEndian32(header + 28)) {
+        return false;
+    }
+
+    image.walBigEndian = bigEndian;
+    image.walSalt1 = ReadBigEndian32(header + 16);
+    image.walSalt2 = ReadBigEndian32(header + 20);
+    image.walChecksum0 = s0;
+    image.walChecksum1 = s1;
+    image.walOffset = 32;
+    return true;
+}
+
+// Copies committed frames into the image. frames must start at image.walOffset in the WAL file.
+// Stops at the first frame with a stale salt or bad checksum, like SQLite's own WAL recovery,
+// and leaves frames of an unfinished transaction to be picked up by the next refresh.
+void ApplyWalFrames(HistoryImage& image, const unsigned char* frames, size_t length, HistoryRefreshStats& stats) {
+    const size_t pageSize = image.pageSize;
+    const size_t frameSize = 24 + pageSize;
+    uint32_t s0 = image.walChecksum0, s1 = image.walChecksum1;
+    size_t committedEnd = 0;
+
+    for (size_t offset = 0; offset + frameSize <= length; offset += frameSize) {
+        const unsigned char* frame = frames + offset;
+        if (ReadBigEndian32(frame + 8) != image.walSalt1 || ReadBigEndian32(frame + 12) != image.walSalt2) {
+            break;
+        }
+
+        WalChecksum(image.walBigEndian, frame, 8, s0, s1);
+        WalChecksum(image.walBigEndian, frame + 24, pageSize, s0, s1);
+        if (s0 != ReadBigEndian32(frame + 16) || s1 != ReadBigEndian32(frame + 20)) {
+            break;
+        }
+
+        // A non-zero database size marks the commit frame of a transaction
+        uint32_t commitPages = ReadBigEndian32(frame + 4);
+        if (commitPages == 0) {
+            continue;
+        }
+
+        for (size_t frameOffset = committedEnd; frameOffset <= offset; frameOffset += frameSize) {
+            uint32_t pageNumber = ReadBigEndian32(frames + frameOffset);
+            if (pageNumber == 0) {
+                continue;
+            }
+
+            size_t pagePos = static_cast<size_t>(pageNumber - 1) * pageSize;
+            if (image.data.size() < pagePos + pageSize) {
+                image.data.resize(pagePos + pageSize);
+            }
+            memcpy(image.data.data() + pagePos, frames + frameOffset + 24, pageSize);
+            image.walPages.push_back(pageNumber);
+            stats.bytesWritten += pageSize;
+        }
+        image.data.resize(static_cast<size_t>(commitPages) * pageSize);
+
+        committedEnd = offset + frameSize;
+        image.walChecksum0 = s0;
+        image.walChecksum1 = s1;
+    }
+
+    image.walOffset += committedEnd;
+}
+
+struct MemoryFile {
+    sqlite3_file base;
+    const HistoryImage* image;
+};
+
+int MemoryFileClose(sqlite3_file*) {
+    return SQLITE_OK;
+}
+
+int MemoryFileRead(sqlite3_file* file, void* buffer, int amount, sqlite3_int64 offset) {
+    const std::vector<unsigned char>& data = reinterpret_cast<MemoryFile*>(file)->image->data;
+    size_t available = offset < static_cast<sqlite3_int64>(data.size()) ? data.size() - static_cast<size_t>(offset) : 0;
+    size_t count = (std::min)(available, static_cast<size_t>(amount));
+
+    if (count > 0) {
+        memcpy(buffer, data.data() + offset, count);
+    }
+    if (count < static_cast<size_t>(amount)) {
+        // SQLite requires the unread tail to be zero-filled on a short read
+        memset(static_cast<unsigned char*>(buffer) + count, 0, amount - count);
+        return SQLITE_IOERR_SHORT_READ;
+    }
+    return SQLITE_OK;
+}
+
+int MemoryFileWrite(sqlite3_file*, const void*, int, sqlite3_int64) {
+    return SQLITE_READONLY;
+}
+
+int MemoryFileTruncate(sqlite3_file*, sqlite3_int64) {
+    return SQLITE_READONLY;
+}
+
+int MemoryFileSync(sqlite3_file*, int) {
+    return SQLITE_OK;
+}
+
+int MemoryFileSize(sqlite3_file* file, sqlite3_int64* size) {
+    *size = static_cast<sqlite3_int64>(reinterpret_cast<MemoryFile*>(file)->image->data.size());
+    return SQLITE_OK;
+}
+
+int MemoryFileLock(sqlite3_file*, int) {
+    return SQLITE_OK;
+}
+
+int MemoryFileCheckReservedLock(sqlite3_file*, int* result) {
+    *result = 0;
+    return SQLITE_OK;
+}
+
+int MemoryFileControl(sqlite3_file*, int, void*) {
+    return SQLITE_NOTFOUND;
+}
+
+int MemoryFileSectorSize(sqlite3_file*) {
+    return 4096;
+}
+
+int MemoryFileDeviceCharacteristics(sqlite3_file*) {
+    return SQLITE_IOCAP_IMMUTABLE;
+}
+
+const sqlite3_io_methods g_MemoryFileMethods = {
+    1,
+    MemoryFileClose,
+    MemoryFileRead,
+    MemoryFileWrite,
+    MemoryFileTruncate,
+    MemoryFileSync,
+    MemoryFileSize,
+    MemoryFileLock,
+    MemoryFileLock,
+    MemoryFileCheckReservedLock,
+    MemoryFileControl,
+    MemoryFileSectorSize,
+    MemoryFileDeviceCharacteristics,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+// File names carry the image address: "msb-history-<hex address>". Temp files are refused,
+// so connections run with temp_store=MEMORY (see OpenHistoryImage).
+int MemoryVfsOpen(sqlite3_vfs*, sqlite3_filename name, sqlite3_file* file, int flags, int* outFlags) {
+    MemoryFile* memoryFile = reinterpret_cast<MemoryFile*>(file);
+    memoryFile->base.pMethods = nullptr;
+
+    size_t prefixLength = strlen(kMemoryFilePrefix);
+    if (!name || !(flags & SQLITE_OPEN_MAIN_DB) || strncmp(name, kMemoryFilePrefix, prefixLength) != 0) {
+        return SQLITE_CANTOPEN;
+    }
+
+    memoryFile->image = reinterpret_cast<const HistoryImage*>(
+        static_cast<uintptr_t>(strtoull(name + prefixLength, nullptr, 16)));
+    if (!memoryFile->image) {
+        return SQLITE_CANTOPEN;
+    }
+
+    memoryFile->base.pMethods = &g_MemoryFileMethods;
+    if (outFlags) {
+        *outFlags = SQLITE_OPEN_READONLY;
+    }
+    return SQLITE_OK;
+}
+
+int MemoryVfsDelete(sqlite3_vfs*, const char*, int) {
+    return SQLITE_IOERR_DELETE;
+}
+
+// No journal or WAL ever exists next to an in-memory image
+int MemoryVfsAccess(sqlite3_vfs*, const char*, int, int* result) {
+    *result = 0;
+    return SQLITE_OK;
+}
+
+int MemoryVfsFullPathname(sqlite3_vfs*, const char* name, int outSize, char* out) {
+    sqlite3_snprintf(outSize, out, "%s", name);
+    return SQLITE_OK;
+}
+
+// Everything that is not file I/O goes to the platform VFS
+sqlite3_vfs* DefaultVfs(sqlite3_vfs* vfs) {
+    return static_cast<sqlite3_vfs*>(vfs->pAppData);
+}
+
+void* MemoryVfsDlOpen(sqlite3_vfs* vfs, const char* fileName) {
+    return DefaultVfs(vfs)->xDlOpen(DefaultVfs(vfs), fileName);
+}
+
+void MemoryVfsDlError(sqlite3_vfs* vfs, int size, char* message) {
+    DefaultVfs(vfs)->xDlError(DefaultVfs(vfs), size, message);
+}
+
+void (*MemoryVfsDlSym(sqlite3_vfs* vfs, void* handle, const char* symbol))(void) {
+    return DefaultVfs(vfs)->xDlSym(DefaultVfs(vfs), handle, symbol);
+}
+
+void MemoryVfsDlClose(sqlite3_vfs* vfs, void* handle) {
+    DefaultVfs(vfs)->xDlClose(DefaultVfs(vfs), handle);
+}
+
+int MemoryVfsRandomness(sqlite3_vfs* vfs, int size, char* out) {
+    return DefaultVfs(vfs)->xRandomness(DefaultVfs(vfs), size, out);
+}
+
+int MemoryVfsSleep(sqlite3_vfs* vfs, int microseconds) {
+    return DefaultVfs(vfs)->xSleep(DefaultVfs(vfs), microseconds);
+}
+
+int MemoryVfsCurrentTime(sqlite3_vfs* vfs, double* now) {
+    return DefaultVfs(vfs)->xCurrentTime(DefaultVfs(vfs), now);
+}
+
+int MemoryVfsGetLastError(sqlite3_vfs* vfs, int size, char* message) {
+    return DefaultVfs(vfs)->xGetLastError(DefaultVfs(vfs), size, message);
+}
+
+bool RegisterMemoryVfs() {
+    static sqlite3_vfs memoryVfs;
+    static std::once_flag registerOnce;
+    static bool registered = false;
+
+    std::call_once(registerOnce, []() {
+        sqlite3_vfs* defaultVfs = sqlite3_vfs_find(nullptr);
+        if (!defaultVfs) {
+            return;
+        }
+
+        memoryVfs.iVersion = 1;
+        memoryVfs.szOsFile = sizeof(MemoryFile);
+        memoryVfs.mxPathname = 256;
+        memoryVfs.zName = kMemoryVfsName;
+        memoryVfs.pAppData = defaultVfs;
+        memoryVfs.xOpen = MemoryVfsOpen;
+        memoryVfs.xDelete = MemoryVfsDelete;
+        memoryVfs.xAccess = MemoryVfsAccess;
+        memoryVfs.xFullPathname = MemoryVfsFullPathname;
+        memoryVfs.xDlOpen = MemoryVfsDlOpen;
+        memoryVfs.xDlError = MemoryVfsDlError;
+        memoryVfs.xDlSym = MemoryVfsDlSym;
+        memoryVfs.xDlClose = MemoryVfsDlClose;
+        memoryVfs.xRandomness = MemoryVfsRandomness;
+        memoryVfs.xSleep = MemoryVfsSleep;
+        memoryVfs.xCurrentTime = MemoryVfsCurrentTime;
+        memoryVfs.xGetLastError = MemoryVfsGetLastError;
+        registered = sqlite3_vfs_register(&memoryVfs, 0) == SQLITE_OK;
+    });
+
+    return registered;
+}
+
+// Opens a read-only connection over an image; the image must outlive the connection
+// and must not be refreshed while it is open
+sqlite3* OpenHistoryImage(const HistoryImage& image) {
+    if (image.data.size() < 100 || !RegisterMemoryVfs()) {
+        return nullptr;
+    }
+
+    char name[64];
+    sqlite3_snprintf(sizeof(name), name, "%s%llx", kMemoryFilePrefix,
+                     static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(&image)));
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(name, &db, SQLITE_OPEN_READONLY, kMemoryVfsName) != SQLITE_OK) {
+        sqlite3_close(db);
+        return nullptr;
+    }
+
+    // The VFS can only open the image itself, so sorters and temp tables must not spill to files
+    if (sqlite3_exec(db, "PRAGMA temp_store=MEMORY", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        sqlite3_close(db);
+        return nullptr;
+    }
+    return db;
+}
+
+// Rereads the main file page by page and rewrites only pages whose checksum changed.
+// Pages that held WAL content are always restored, since the WAL is reapplied afterwards.
+// Returns false when cancelled part way; the image is then marked so the next refresh
+// rescans every page and replays the whole WAL.
+bool RefreshMainPages(HANDLE file, uint64_t fileSize, HistoryImage& image, HistoryRefreshStats& stats, const LoadToken& token) {
+    const size_t pageSize = image.pageSize;
+    const size_t pageCount = static_cast<size_t>(fileSize / pageSize);
+    const size_t previousSize = (std::min)(image.data.size(), static_cast<size_t>(image.mainFileSize));
+
+    std::vector<bool> forcedPages(pageCount, false);
+    for (uint32_t pageNumber : image.walPages) {
+        if (pageNumber - 1 < pageCount) {
+            forcedPages[pageNumber - 1] = true;
+        }
+    }
+
+    image.data.resize(pageCount * pageSize);
+    image.pageChecksums.resize(pageCount, 0);
+
+    const size_t pagesPerChunk = std::max<size_t>(1, (1 << 20) / pageSize);
+    std::vector<unsigned char> chunk(pagesPerChunk * pageSize);
+
+    for (size_t firstPage = 0; firstPage < pageCount; firstPage += pagesPerChunk) {
+        if (token.IsCancelled()) {
+            image.mainFileSize = 0;
+            image.walOffset = 0;
+            return false;
+        }
+
+        size_t pages = (std::min)(pagesPerChunk, pageCount - firstPage);
+        size_t bytesRead = ReadFileAt(file, static_cast<uint64_t>(firstPage) * pageSize, chunk.data(), pages * pageSize);
+        stats.bytesRead += bytesRead;
+
+        for (size_t i = 0; i < bytesRead / pageSize; ++i) {
+            size_t page = firstPage + i;
+            size_t pagePos = page * pageSize;
+            uint64_t checksum = HashBytes(chunk.data() + i * pageSize, pageSize);
+
+            if (forcedPages[page] || pagePos >= previousSize || checksum != image.pageChecksums[page]) {
+                memcpy(image.data.data() + pagePos, chunk.data() + i * pageSize, pageSize);
+                image.pageChecksums[page] = checksum;
+                stats.bytesWritten += pageSize;
+            }
+        }
+    }
+
+    image.mainFileSize = fileSize;
+    image.walPages.clear();
+    return true;
+}
+
+// Brings the image up to date with History and History-wal.
+// Page 1 and the WAL header are always read; the main file is only rescanned when one of
+// them (or the file size) changed, and only WAL frames past the last commit seen are read.
+bool RefreshHistoryImage(const std::wstring& historyPath, HistoryImage& image, HistoryRefreshStats& stats, const LoadToken& token) {
+    HANDLE file = OpenSharedFile(historyPath);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    uint64_t fileSize = GetOpenFileSize(file);
+    unsigned char header[100];
+    if (ReadFileAt(file, 0, header, sizeof(header)) != sizeof(header)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // Page size is stored big-endian at offset 16, with 1 meaning 65536
+    uint32_t pageSize = (static_cast<uint32_t>(header[16]) << 8) | header[17];
+    if (pageSize == 1) {
+        pageSize = 65536;
+    }
+    if (pageSize < 512 || (pageSize & (pageSize - 1)) != 0 || fileSize < pageSize) {
+        CloseHandle(file);
+        return false;
+    }
+
+    std::vector<unsigned char> firstPage(pageSize);
+    stats.bytesRead += ReadFileAt(file, 0, firstPage.data(), pageSize);
+
+    HANDLE walFile = OpenSharedFile(historyPath + L"-wal");
+    uint64_t walSize = 0;
+    unsigned char walHeader[32];
+    bool walValid = false;
+    if (walFile != INVALID_HANDLE_VALUE) {
+        walSize = GetOpenFileSize(walFile);
+        walValid = walSize >= sizeof(walHeader) && ReadFileAt(walFile, 0, walHeader, sizeof(walHeader)) == sizeof(walHeader);
+        stats.bytesRead += walValid ? sizeof(walHeader) : 0;
+    }
+
+    // A WAL that disappeared, restarted with new salts or shrank has been checkpointed into the main file
+    bool walRestarted = image.walOffset != 0 &&
+        (!walValid || walSize < image.walOffset ||
+         ReadBigEndian32(walHeader + 16) != image.walSalt1 || ReadBigEndian32(walHeader + 20) != image.walSalt2);
+
+    bool mainChanged = image.data.empty() || pageSize != image.pageSize || fileSize != image.mainFileSize ||
+                       image.pageChecksums.empty() || HashBytes(firstPage.data(), pageSize) != image.pageChecksums[0] ||
+                       walRestarted;
+
+    if (mainChanged) {
+        if (pageSize != image.pageSize) {
+            image = HistoryImage();
+            image.pageSize = pageSize;
+        }
+        if (!RefreshMainPages(file, fileSize, image, stats, token)) {
+            CloseHandle(file);
+            if (walFile != INVALID_HANDLE_VALUE) {
+                CloseHandle(walFile);
+            }
+            return false;
+        }
+        image.walOffset = 0;
+    }
+    CloseHandle(file);
+
+    if (walValid) {
+        if (image.walOffset == 0 && !BeginWal(image, walHeader)) {
+            walValid = false;
+        }
+        if (walValid && walSize > image.walOffset && !token.IsCancelled()) {
+            std::vector<unsigned char> frames(static_cast<size_t>(walSize - image.walOffset));
+            size_t bytesRead = ReadFileAt(walFile, image.walOffset, frames.data(), frames.size());
+            stats.bytesRead += bytesRead;
+            ApplyWalFrames(image, frames.data(), bytesRead, stats);
+        }
+    }
+    if (walFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(walFile);
+    }
+
+    // The WAL is folded in, so mark the image as a rollback-journal database
+    if (image.data.size() >= 100 && image.data[18] == 2 && image.data[19] == 2) {
+        image.data[18] = 1;
+        image.data[19] = 1;
+    }
+    return image.data.size() >= 100 && !token.IsCancelled();
+}
+
+/*
+* Snapshot Chrome DB
+*/
+
+// Builds a "file:" URI for sqlite3_open_v2 with the given query parameters
+std::string MakeSqliteUri(const std::wstring& path, const char* params) {
+    std::string uri = "file:///";
+    for (char c : WideToUtf8(path)) {
+        switch (c) {
+        case '\\': uri += '/'; break;
+        case '%': uri += "%25"; break;
+        case '?': uri += "%3f"; break;
+        case '#': uri += "%23"; break;
+        case ' ': uri += "%20"; break;
+        default: uri += c; break;
+        }
+    }
+    uri += '?';
+    uri += params;
+    return uri;
+}
+
+// Copies every page of source (including pages still in its WAL) into a new in-memory database.
+// Pages are copied in steps so a cancelled load stops between them.
+sqlite3* BackupToMemory(sqlite3* source, const LoadToken& token) {
+    sqlite3* memoryDb = nullptr;
+    if (sqlite3_open(":memory:", &memoryDb) != SQLITE_OK) {
+        sqlite3_close(memoryDb);
+        return nullptr;
+    }
+
+    // A locked source makes the step return SQLITE_BUSY, which finish does not report
+    int rc = SQLITE_ERROR;
+    sqlite3_backup* backup = sqlite3_backup_init(memoryDb, "main", source, "main");
+    if (backup) {
+        do {
+            rc = sqlite3_backup_step(backup, 256);
+        } while (rc == SQLITE_OK && !token.IsCancelled());
+        if (sqlite3_backup_finish(backup) != SQLITE_OK) {
+            rc = SQLITE_ERROR;
+        }
+    }
+
+    if (rc != SQLITE_DONE) {
+        sqlite3_close(memoryDb);
+        return nullptr;
+    }
+    return memoryDb;
+}
+
+// Opens the live History database through a URI and snapshots it into memory.
+// When keepSource is given, a working source connection is kept open there and reused.
+sqlite3* SnapshotFromUri(const std::wstring& historyPath, const char* params, sqlite3** keepSource, const LoadToken& token) {
+    sqlite3* source = keepSource ? *keepSource : nullptr;
+    sqlite3* snapshot = nullptr;
+
+    if (!source) {
+        std::string uri = MakeSqliteUri(historyPath, params);
+        if (sqlite3_open_v2(uri.c_str(), &source, SQLITE_OPEN_READONLY | SQLITE_OPEN_URI, nullptr) != SQLITE_OK) {
+            sqlite3_close(source);
+            source = nullptr;
+        }
+    }
+    if (source) {
+        snapshot = BackupToMemory(source, token);
+    }
+
+    if (keepSource && snapshot) {
+        *keepSource = source;
+    }
+    else {
+        sqlite3_close(source);
+        if (keepSource) {
+            *keepSource = nullptr;
+        }
+    }
+    return snapshot;
+}
+
+// Returns a private snapshot of the profile's History database, or nullptr.
+// Stages are tried from cheapest to most expensive I/O:
+//   1. read-only URI on the live file (sees committed WAL content); the connection is
+//      kept in historySource so later loads and the change probe can reuse it
+//   2. immutable URI, which skips locking when Chrome holds the file exclusively
+//   3. delta refresh of the parent's private image, served by the memory VFS
+sqlite3* OpenChromeHistorySnapshot(const std::wstring& profile, HistoryImage& image, sqlite3*& historySource,
+                                   const LoadToken& token, LoadLog& log) {
+    std::wstring historyPath = GetChromeHistoryPath(profile);
+    if (!std::filesystem::exists(historyPath)) {
+        log.Add(LOG_ERROR, L"Chrome History file not found.");
+        return nullptr;
+    }
+
+    struct Stage {
+        LPCWSTR name;
+        const char* params;
+        bool persistent;
+    };
+    const Stage uriStages[] = {
+        { L"read-only URI", "mode=ro", true },
+        { L"immutable URI", "mode=ro&immutable=1", false },
+    };
+
+    for (const Stage& stage : uriStages) {
+        if (token.IsCancelled()) {
+            return nullptr;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        sqlite3* snapshot = SnapshotFromUri(historyPath, stage.params, stage.persistent ? &historySource : nullptr, token);
+        long long elapsed = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count());
+
+        log.Add(LOG_DEBUG, L"History snapshot via %s: %s in %lld ms", stage.name, snapshot ? L"ok" : L"failed", elapsed);
+        if (snapshot) {
+            return snapshot;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    HistoryRefreshStats stats;
+    sqlite3* db = RefreshHistoryImage(historyPath, image, stats, token) ? OpenHistoryImage(image) : nullptr;
+    long long elapsed = static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    log.Add(LOG_DEBUG, L"History snapshot via memory image (read %llu KB, rewrote %llu KB of %llu KB): %s in %lld ms",
+            static_cast<unsigned long long>(stats.bytesRead / 1024), static_cast<unsigned long long>(stats.bytesWritten / 1024),
+            static_cast<unsigned long long>(image.data.size() / 1024), db ? L"ok" : L"failed", elapsed);
+    return db;
+}
+
+/*
+* History Change Detection
+*/
+
+// Tells whether a watched location may have been written to since the previous Poll().
+// Implementations must never miss a write; a false positive only costs a stat call.
+class ChangeWatcher {
+public:
+    virtual ~ChangeWatcher() {}
+    virtual bool Poll() = 0;
+};
+
+// Directory change notification on the folder holding History and History-wal
+class DirectoryChangeWatcher : public ChangeWatcher {
+public:
+    explicit DirectoryChangeWatcher(const std::wstring& directory)
+        : handle(FindFirstChangeNotificationW(directory.c_str(), FALSE, FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE)) {}
+
+    ~DirectoryChangeWatcher() override {
+        if (handle != INVALID_HANDLE_VALUE) {
+            FindCloseChangeNotification(handle);
+        }
+    }
+
+    bool Poll() override {
+        if (handle == INVALID_HANDLE_VALUE) {
+            return true;
+        }
+        if (WaitForSingleObject(handle, 0) != WAIT_OBJECT_0) {
+            return false;
+        }
+        FindNextChangeNotification(handle);
+        return true;
+    }
+
+private:
+    DirectoryChangeWatcher(const DirectoryChangeWatcher&) = delete;
+    DirectoryChangeWatcher& operator=(const DirectoryChangeWatcher&) = delete;
+
+    HANDLE handle;
+};
+
+struct FileStamp {
+    bool exists;
+    uint64_t size;
+    uint64_t writeTime;
+
+    FileStamp() : exists(false), size(0), writeTime(0) {}
+
+    bool operator==(const FileStamp& other) const {
+        return exists == other.exists && size == other.size && writeTime == other.writeTime;
+    }
+};
+
+FileStamp GetFileStamp(const std::wstring& path) {
+    FileStamp stamp;
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes)) {
+        stamp.exists = true;
+        stamp.size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+        stamp.writeTime = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+                          attributes.ftLastWriteTime.dwLowDateTime;
+    }
+    return stamp;
+}
+
+sqlite3_int64 GetDataVersion(sqlite3* db) {
+    sqlite3_int64 version = -1;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "PRAGMA data_version", -1, &stmt, nullptr) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            version = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    return version;
+}
+
+// Cheap check run before any snapshot or query. Reports a change when size or mtime of
+// History or History-wal moved, or when PRAGMA data_version on the persistent source
+// connection moved. A watcher that has not fired skips those checks entirely.
+// The observed state only becomes the baseline once Commit() is called after a
+// successful load, so a failed load is retried next time.
+class HistoryChangeProbe {
+public:
+    HistoryChangeProbe() : hasBaseline(false), changePending(false), dataVersion(-1), pendingDataVersion(-1) {}
+
+    void Reset(const std::wstring& path, std::unique_ptr<ChangeWatcher> changeWatcher) {
+        historyPath = path;
+        watcher = std::move(changeWatcher);
+        hasBaseline = false;
+        changePending = false;
+    }
+
+    bool HasChanged(sqlite3* persistentSource) {
+        if (hasBaseline && !changePending && watcher && !watcher->Poll()) {
+            return false;
+        }
+
+        pendingHistory = GetFileStamp(historyPath);
+        pendingWal = GetFileStamp(historyPath + L"-wal");
+        pendingDataVersion = persistentSource ? GetDataVersion(persistentSource) : -1;
+
+        changePending = !hasBaseline ||
+                        !(pendingHistory == historyStamp) || !(pendingWal == walStamp) ||
+                        pendingDataVersion != dataVersion;
+        return changePending;
+    }
+
+    void Commit() {
+        historyStamp = pendingHistory;
+        walStamp = pendingWal;
+        dataVersion = pendingDataVersion;
+        hasBaseline = true;
+        changePending = false;
+    }
+
+private:
+    std::wstring historyPath;
+    std::unique_ptr<ChangeWatcher> watcher;
+
+    bool hasBaseline;
+    bool changePending;
+    FileStamp historyStamp;
+    FileStamp walStamp;
+    sqlite3_int64 dataVersion;
+
+    FileStamp pendingHistory;
+    FileStamp pendingWal;
+    sqlite3_int64 pendingDataVersion;
+};
+
+/*
+* Parse Chrome History
+*/
+
+// Returns the titles of the most recently visited URLs, newest first, one entry per title.
+// maxItems > 0 caps the number of titles both in SQL and while stepping. Every load runs
+// the whole query again, so a title whose visits were deleted drops out or moves down
+// as soon as Chrome writes; the change probe keeps an unchanged file from being queried.
+// Returns false if the query failed or was cancelled; titles are then left empty.
+bool GetLastHistoryTitles(sqlite3* db, int maxItems, const LoadToken& token, TitleStore& titles) {
+    TitleStore historyTitles;
+    FlatStringSet<char> seenTitles(maxItems > 0 ? static_cast<size_t>(maxItems) : 1024);
+    const size_t limit = maxItems > 0 ? static_cast<size_t>(maxItems) : SIZE_MAX;
+
+    // One row per title, ordered by its latest visit; ties keep a stable order so an
+    // unchanged history gives identical snapshots
+    const char* query =
+        "SELECT title, MAX(last_visit_time) AS visit FROM urls "
+        "GROUP BY title ORDER BY visit DESC, title LIMIT ?1";
+
+    // Chrome has no index on last_visit_time, so GROUP BY scans and sorts every row before
+    // the first step returns; check for cancellation inside SQLite as well as between rows
+    sqlite3_progress_handler(db, 1000, CancelProgressHandler, const_cast<LoadToken*>(&token));
+
+    bool succeeded = false;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, query, -1, &stmt, nullptr) == SQLITE_OK) {
+        sqlite3_bind_int(stmt, 1, maxItems > 0 ? maxItems : -1);
+
+        int rc = SQLITE_ROW;
+        while (historyTitles.Size() < limit && !token.IsCancelled() && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            // Deduplicate on the raw UTF-8 bytes; titles stay UTF-8 until a child reads them
+            const char* title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            std::string_view utf8Title = title ? std::string_view(title, sqlite3_column_bytes(stmt, 0))
+                                               : std::string_view("(No Title)");
+
+            if (seenTitles.Insert(utf8Title)) {
+                historyTitles.Append(utf8Title);
+            }
+        }
+        sqlite3_finalize(stmt);
+
+        // Stepping stops on SQLITE_DONE, on the limit (rc is still SQLITE_ROW) or on an error
+        succeeded = rc == SQLITE_DONE || rc == SQLITE_ROW;
+    }
+
+    sqlite3_progress_handler(db, 0, nullptr, nullptr);
+    if (!succeeded || token.IsCancelled()) {
+        titles = TitleStore();
+        return false;
+    }
+
+    titles = std::move(historyTitles);
+    return true;
+}
+
+/*
+* Parse Trends Feed
+
+*/
+
+// Mask must be non-zero
+inline unsigned CountTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Offset of the first byte equal to first or second, or length if there is none.
+// Compares 32 or 16 bytes per step and turns the match mask into an offset.
+size_t FindEither(const char* data, size_t length, char first, char second) {
+    size_t i = 0;
+#if MSB_USE_AVX2
+    const __m256i first32 = _mm256_set1_epi8(first);
+    const __m256i second32 = _mm256_set1_epi8(second);
+    for (; i + 32 <= length; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, first32), _mm256_cmpeq_epi8(chunk, second32))));
+        if (mask != 0) {
+            return i + CountTrailingZeros(mask);
+        }
+    }
+#endif
+#if MSB_USE_SSE2
+    const __m128i first16 = _mm_set1_epi8(first);
+    const __m128i second16 = _mm_set1_epi8(second);
+    for (; i + 16 <= length; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, first16), _mm_cmpeq_epi8(chunk, second16))));
+        if (mask != 0) {
+            return i + CountTrailingZeros(mask);
+        }
+    }
+#endif
+    for (; i < length; ++i) {
+        if (data[i] == first || data[i] == second) {
+            return i;
+        }
+    }
+    return length;
+}
+
+// Incremental RSS/Atom title tokenizer. Feed() accepts the response in chunks of any
+// size, and tags, entities, CDATA sections and comments may be split anywhere between
+// them. Titles of <item> (RSS) and <entry> (Atom) elements are decoded into one reused
+// buffer and passed to the callback as a string_view that is only valid during the call.
+// Text, CDATA and comment bodies are skipped or copied in bulk up to the next byte that
+// can change state, found with FindEither; only tags and entities go byte by byte.
+class FeedTitleParser {
+public:
+    FeedTitleParser() : state(State::Text), inItem(false), collecting(false), closingTag(false),
+                        selfClosing(false), quote(0), markerCount(0) {}
+
+    // Calls onTitle(std::string_view) for every title; returning false from it stops
+    // parsing, and Feed() then returns false as well
+    template <typename Callback>
+    bool Feed(const char* data, size_t length, Callback&& onTitle) {
+        for (size_t i = 0; i < length;) {
+            char c = data[i];
+            switch (state) {
+            case State::Text:
+                if (c != '<' && c != '&') {
+                    size_t run = collecting ? FindEither(data + i, length - i, '<', '&')
+                                            : FindEither(data + i, length - i, '<', '<');
+                    if (collecting) {
+                        title.append(data + i, run);
+                    }
+                    i += run;
+                    continue;
+                }
+
+                if (c == '<') {
+                    state = State::TagName;
+                    tagName.clear();
+                    closingTag = selfClosing = false;
+                }
+                else if (collecting) {
+                    state = State::Entity;
+                    entity.clear();
+                }
+                break;
+
+            case State::TagName:
+                if (c == '>') {
+                    if (!FinishTag(onTitle)) {
+                        return false;
+                    }
+                }
+                else if (c == '/' && tagName.empty() && !closingTag) {
+                    closingTag = true;
+                }
+                else if (c == '/' || IsSpace(c)) {
+                    selfClosing = (c == '/');
+                    state = State::TagRest;
+                }
+                else {
+                    if (tagName.size() < kMaxTagName) {
+                        tagName += c;
+                    }
+                    if (tagName == "!--") {
+                        state = State::Comment;
+                        markerCount = 0;
+                    }
+                    else if (tagName == "![CDATA[") {
+                        state = State::CData;
+                        markerCount = 0;
+                    }
+                }
+                break;
+
+            case State::TagRest:
+                // Attribute values may contain '>' and '/'
+                if (quote) {
+                    if (c == quote) {
+                        quote = 0;
+                    }
+                }
+                else if (c == '"' || c == '\'') {
+                    quote = c;
+                }
+                else if (c == '>') {
+                    if (!FinishTag(onTitle)) {
+                        return false;
+                    }
+                }
+                else if (!IsSpace(c)) {
+                    selfClosing = (c == '/');
+                }
+                break;
+
+            case State::Comment:
+                // Ends at "-->"
+                if (c != '-' && markerCount == 0) {
+                    i += FindEither(data + i, length - i, '-', '-');
+                    continue;
+                }
+
+                if (c == '-') {
+                    ++markerCount;
+                }
+                else {
+                    if (c == '>' && markerCount >= 2) {
+                        state = State::Text;
+                    }
+                    markerCount = 0;
+                }
+                break;
+
+            case State::CData:
+                // Ends at "]]>"; brackets that turn out not to close it are content
+                if (c != ']' && markerCount == 0) {
+                    size_t run = FindEither(data + i, length - i, ']', ']');
+                    if (collecting) {
+                        title.append(data + i, run);
+                    }
+                    i += run;
+                    continue;
+                }
+
+                if (c == ']') {
+                    ++markerCount;
+                }
+                else if (c == '>' && markerCount >= 2) {
+                    AppendBrackets(markerCount - 2);
+                    state = State::Text;
+                    markerCount = 0;
+                }
+                else {
+                    AppendBrackets(markerCount);
+                    markerCount = 0;
+                    if (collecting) {
+                        title += c;
+                    }
+                }
+                break;
+
+            case State::Entity:
+                if (c == ';') {
+                    DecodeEntity();
+                    state = State::Text;
+                }
+                else if (entity.size() < kMaxEntity && (IsAlnum(c) || (c == '#' && entity.empty()))) {
+                    entity += c;
+                }
+                else {
+                    // Not an entity after all: keep the text and look at c again as text
+                    title += '&';
+                    title += entity;
+                    state = State::Text;
+                    continue;
+                }
+                break;
+            }
+            ++i;
+        }
+        return true;
+    }
+
+private:
+    enum class State { Text, TagName, TagRest, Comment, CData, Entity };
+
+    static const size_t kMaxTagName = 16;
+    static const size_t kMaxEntity = 10;
+
+    static bool IsSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    static bool IsAlnum(char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    void AppendBrackets(size_t count) {
+        if (collecting) {
+            title.append(count, ']');
+        }
+    }
+
+    template <typename Callback>
+    bool FinishTag(Callback& onTitle) {
+        state = State::Text;
+        quote = 0;
+        if (selfClosing) {
+            return true;
+        }
+
+        if (tagName == "item" || tagName == "entry") {
+            inItem = !closingTag;
+            collecting = false;
+        }
+        else if (tagName == "title") {
+            if (!closingTag && inItem) {
+                collecting = true;
+                title.clear();
+            }
+            else if (closingTag && collecting) {
+                collecting = false;
+                return onTitle(Trimmed());
+            }
+        }
+        return true;
+    }
+
+    std::string_view Trimmed() const {
+        size_t begin = 0;
+        size_t end = title.size();
+        while (begin < end && IsSpace(title[begin])) {
+            ++begin;
+        }
+        while (end > begin && IsSpace(title[end - 1])) {
+            --end;
+        }
+        return std::string_view(title).substr(begin, end - begin);
+    }
+
+    // Appends the decoded entity; unknown ones are kept as written
+    void DecodeEntity() {
+        uint32_t codePoint = 0;
+        if (entity == "amp") codePoint = '&';
+        else if (entity == "lt") codePoint = '<';
+        else if (entity == "gt") codePoint = '>';
+        else if (entity == "quot") codePoint = '"';
+        else if (entity == "apos") codePoint = '\'';
+        else if (entity.size() > 1 && entity[0] == '#') {
+            bool hex = entity[1] == 'x' || entity[1] == 'X';
+            const char* digits = entity.c_str() + (hex ? 2 : 1);
+            char* end = nullptr;
+            unsigned long value = strtoul(digits, &end, hex ? 16 : 10);
+            if (*digits && *end == '\0') {
+                codePoint = (value == 0 || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF)) ? 0xFFFD : static_cast<uint32_t>(value);
+            }
+        }
+
+        if (codePoint == 0) {
+            title += '&';
+            title += entity;
+            title += ';';
+        }
+        else if (codePoint < 0x80) {
+            title += static_cast<char>(codePoint);
+        }
+        else if (codePoint < 0x800) {
+            title += static_cast<char>(0xC0 | (codePoint >> 6));
+            title += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else if (codePoint < 0x10000) {
+            title += static_cast<char>(0xE0 | (codePoint >> 12));
+            title += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            title += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+        else {
+            title += static_cast<char>(0xF0 | (codePoint >> 18));
+            title += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            title += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            title += static_cast<char>(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    State state;
+    bool inItem;
+    bool collecting;
+    bool closingTag;
+    bool selfClosing;
+    char quote;
+    size_t markerCount;  // Run of '-' in a comment or ']' in a CDATA section
+    std::string tagName;
+    std::string entity;
+    std::string title;
+};
+
+/*
+* HTTP Client
+*/
+
+// One HTTP response being read. Bodies arrive already decoded (see WinInetTransport).
+class HttpResponse {
+public:
+    virtual ~HttpResponse() {}
+
+    virtual uint32_t StatusCode() = 0;
+
+    // Returns an empty string if the response has no such header
+    virtual std::wstring Header(const wchar_t* name) = 0;
+
+    // Reads the next part of the body; bytesRead is 0 at the end
+    virtual bool Read(void* buffer, size_t size, size_t& bytesRead) = 0;
+};
+
+// What the feed fetcher talks to. Kept apart from WinINet so the fetch logic above it
+// does not depend on how connections are made.
+class HttpTransport {
+public:
+    virtual ~HttpTransport() {}
+
+    // Sends a GET with extra "Name: value\r\n" headers. Returns nullptr if no response arrived.
+    virtual std::unique_ptr<HttpResponse> Get(const std::wstring& url, const std::wstring& headers) = 0;
+};
+
+class WinInetResponse : public HttpResponse {
+public:
+    explicit WinInetResponse(HINTERNET hRequest) : hRequest(hRequest) {}
+
+    ~WinInetResponse() {
+        InternetCloseHandle(hRequest);
+    }
+
+    uint32_t StatusCode() override {
+        DWORD statusCode = 0;
+        DWORD size = sizeof(statusCode);
+        if (!HttpQueryInfoW(hRequest, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &statusCode, &size, nullptr)) {
+            return 0;
+        }
+        return statusCode;
+    }
+
+    std::wstring Header(const wchar_t* name) override {
+        // HTTP_QUERY_CUSTOM takes the header name in the buffer that receives its value
+        wchar_t buffer[256] = {};
+        size_t nameLength = wcslen(name);
+        if (nameLength >= sizeof(buffer) / sizeof(buffer[0])) {
+            return std::wstring();
+        }
+        wmemcpy(buffer, name, nameLength);
+
+        DWORD size = sizeof(buffer);
+        if (!HttpQueryInfoW(hRequest, HTTP_QUERY_CUSTOM, buffer, &size, nullptr)) {
+            return std::wstring();
+        }
+        return std::wstring(buffer, size / sizeof(wchar_t));
+    }
+
+    bool Read(void* buffer, size_t size, size_t& bytesRead) override {
+        DWORD read = 0;
+        BOOL succeeded = InternetReadFile(hRequest, buffer, static_cast<DWORD>(std::min<size_t>(size, MAXDWORD)), &read);
+        bytesRead = read;
+        return succeeded != FALSE;
+    }
+
+private:
+    HINTERNET hRequest;
+};
+
+// One WinINet session for the whole process, with one connection handle per scheme, host
+// and port. Requests go out with keep-alive, so sockets and TLS sessions stay pooled in
+// the session between refreshes instead of being set up again for every fetch.
+// Response bodies are decoded (gzip/deflate) by WinINet as they are read.
+class WinInetTransport : public HttpTransport {
+public:
+    WinInetTransport() : hSession(InternetOpenW(L"RainmeterPlugin", INTERNET_OPEN_TYPE_PRECONFIG, nullptr, nullptr, 0)) {
+        if (hSession) {
+            BOOL decoding = TRUE;
+            InternetSetOptionW(hSession, INTERNET_OPTION_HTTP_DECODING, &decoding, sizeof(decoding));
+        }
+    }
+
+    ~WinInetTransport() {
+        for (auto& connection : connections) {
+            InternetCloseHandle(connection.second);
+        }
+        if (hSession) {
+            InternetCloseHandle(hSession);
+        }
+    }
+
+    WinInetTransport(const WinInetTransport&) = delete;
+    WinInetTransport& operator=(const WinInetTransport&) = delete;
+
+    std::unique_ptr<HttpResponse> Get(const std::wstring& url, const std::wstring& headers) override {
+        wchar_t hostName[256];
+        wchar_t urlPath[2048];
+        wchar_t extraInfo[2048];
+        URL_COMPONENTSW components = {};
+        components.dwStructSize = sizeof(components);
+        components.lpszHostName = hostName;
+        components.dwHostNameLength = static_cast<DWORD>(sizeof(hostName) / sizeof(hostName[0]));
+        components.lpszUrlPath = urlPath;
+        components.dwUrlPathLength = static_cast<DWORD>(sizeof(urlPath) / sizeof(urlPath[0]));
+        components.lpszExtraInfo = extraInfo;
+        components.dwExtraInfoLength = static_cast<DWORD>(sizeof(extraInfo) / sizeof(extraInfo[0]));
+        if (!hSession || !InternetCrackUrlW(url.c_str(), 0, 0, &components)) {
+            return nullptr;
+        }
+
+        const bool secure = components.nScheme == INTERNET_SCHEME_HTTPS;
+        HINTERNET hConnect = GetConnection(hostName, components.nPort, secure);
+        if (!hConnect) {
+            return nullptr;
+        }
+
+        // INTERNET_FLAG_RELOAD keeps WinINet's own cache out of the way, so a 304 reaches us
+        std::wstring object = std::wstring(urlPath) + extraInfo;
+        DWORD flags = INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_KEEP_CONNECTION;
+        if (secure) {
+            flags |= INTERNET_FLAG_SECURE;
+        }
+        HINTERNET hRequest = HttpOpenRequestW(hConnect, L"GET", object.c_str(), nullptr, nullptr, nullptr, flags, 0);
+        if (!hRequest) {
+            return nullptr;
+        }
+
+        if (!HttpSendRequestW(hRequest, headers.c_str(), static_cast<DWORD>(headers.size()), nullptr, 0)) {
+            InternetCloseHandle(hRequest);
+            return nullptr;
+        }
+        return std::make_unique<WinInetResponse>(hRequest);
+    }
+
+private:
+    // Connection handles are opened once and shared by concurrent requests to the host
+    HINTERNET GetConnection(const wchar_t* hostName, INTERNET_PORT port, bool secure) {
+        std::wstring key = (secure ? L"https://" : L"http://") + std::wstring(hostName) + L":" + std::to_wstring(port);
+
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        auto it = connections.find(key);
+        if (it != connections.end()) {
+            return it->second;
+        }
+
+        HINTERNET hConnect = InternetConnectW(hSession, hostName, port, nullptr, nullptr, INTERNET_SERVICE_HTTP, 0, 0);
+        if (hConnect) {
+            connections.emplace(key, hConnect);
+        }
+        return hConnect;
+    }
+
+    HINTERNET hSession;
+    std::mutex connectionMutex;
+    std::unordered_map<std::wstring, HINTERNET> connections;
+};
+
+// Shared by every trends source. Fetches hold their own reference, so releasing it on
+// the last Finalize only closes the session once no fetch uses it anymore.
+std::mutex g_HttpTransportMutex;
+std::shared_ptr<HttpTransport> g_HttpTransport;
+
+std::shared_ptr<HttpTransport> GetHttpTransport() {
+    std::lock_guard<std::mutex> lock(g_HttpTransportMutex);
+    if (!g_HttpTransport) {
+        g_HttpTransport = std::make_shared<WinInetTransport>();
+    }
+    return g_HttpTransport;
+}
+
+void ReleaseHttpTransport() {
+    std::lock_guard<std::mutex> lock(g_HttpTransportMutex);
+    g_HttpTransport.reset();
+}
+
+/*
+*  Fetch Top Searches
+*/
+
+// Titles that are feed metadata rather than searches
+bool IsTrendTitle(std::string_view utf8Title) {
+    return !utf8Title.empty() &&
+           utf8Title.find("http") == std::string_view::npos &&
+           utf8Title.find("trends.google.com") == std::string_view::npos &&
+           utf8Title.find("Daily Search Trends") == std::string_view::npos &&
+           utf8Title.find("Google Trends") == std::string_view::npos;
+}
+
+// Cache validators of the last feed that was parsed, sent back as a conditional request
+struct FeedValidators {
+    std::wstring etag;
+    std::wstring lastModified;
+};
+
+// Process-wide feed download counters. Byte counts cover only bodies read to the end,
+// since the wire size of a partly read body is unknown; those are counted in truncated.
+// transferredBytes is the Content-Length the server sent, which is the compressed size
+// when the body was encoded; responses without one (chunked) count their decoded size.
+struct FetchCounters {
+    std::atomic<uint64_t> fetches;
+    std::atomic<uint64_t> notModified;
+    std::atomic<uint64_t> compressed;
+    std::atomic<uint64_t> truncated;
+    std::atomic<uint64_t> transferredBytes;
+    std::atomic<uint64_t> decodedBytes;
+
+    FetchCounters() : fetches(0), notModified(0), compressed(0), truncated(0), transferredBytes(0), decodedBytes(0) {}
+};
+
+FetchCounters g_FetchCounters;
+
+// Most decoded bytes read past the last needed title to keep a connection reusable;
+// the whole daily feed is well below this
+const uint64_t kMaxDrainBytes = 512 * 1024;
+
+// Parses the feed while it downloads and stops parsing once maxItems titles were found.
+// The body is requested compressed and inflated chunk by chunk by the transport, so the
+// parser sees plain XML without a full-body buffer in between.
+// A cancelled fetch stops between reads and returns nothing. When validators are known
+// the request is conditional; a 304 sets notModified and returns nothing without parsing.
+// Validators are replaced only after a complete 200 response that yielded titles.
+TitleStore GetTopTrends(HttpTransport& transport, const std::wstring& url, int maxItems, FeedValidators& validators,
+                        bool& notModified, const LoadToken& token) {
+    TitleStore trends;
+    const size_t limit = maxItems > 0 ? static_cast<size_t>(maxItems) : SIZE_MAX;
+    notModified = false;
+
+    std::wstring headers = L"Accept-Encoding: gzip, deflate\r\n";
+    if (!validators.etag.empty()) {
+        headers += L"If-None-Match: " + validators.etag + L"\r\n";
+    }
+    if (!validators.lastModified.empty()) {
+        headers += L"If-Modified-Since: " + validators.lastModified + L"\r\n";
+    }
+
+    std::unique_ptr<HttpResponse> response = transport.Get(url, headers);
+    if (!response) {
+        return trends;
+    }
+
+    ++g_FetchCounters.fetches;
+    uint32_t statusCode = response->StatusCode();
+    if (statusCode == 304) {
+        ++g_FetchCounters.notModified;
+        notModified = true;
+        return trends;
+    }
+
+    char buffer[16384];
+    size_t bytesRead;
+    FeedTitleParser parser;
+
+    auto onTitle = [&trends, limit](std::string_view utf8Title) {
+        if (IsTrendTitle(utf8Title)) {
+            trends.Append(utf8Title);
+        }
+        return trends.Size() < limit;
+    };
+
+    bool complete = false;
+    bool reachedEnd = false;
+    uint64_t decodedBytes = 0;
+    while (!token.IsCancelled()) {
+        if (!response->Read(buffer, sizeof(buffer), bytesRead)) {
+            break;
+        }
+        decodedBytes += bytesRead;
+        reachedEnd = bytesRead == 0;
+        if (reachedEnd || !parser.Feed(buffer, bytesRead, onTitle)) {
+            complete = true;
+            break;
+        }
+    }
+
+    // A connection only returns to the keep-alive pool once its body was read to the end,
+    // so the rest of a feed cut short at maxItems is skipped unparsed. Past the bound,
+    // dropping the connection is cheaper than reading on.
+    if (complete && !reachedEnd) {
+        uint64_t drainedBytes = 0;
+        while (drainedBytes < kMaxDrainBytes && !token.IsCancelled() && response->Read(buffer, sizeof(buffer), bytesRead)) {
+            if (bytesRead == 0) {
+                reachedEnd = true;
+                break;
+            }
+            drainedBytes += bytesRead;
+        }
+        decodedBytes += drainedBytes;
+    }
+
+    if (!response->Header(L"Content-Encoding").empty()) {
+        ++g_FetchCounters.compressed;
+    }
+    if (reachedEnd) {
+        uint64_t contentLength = wcstoull(response->Header(L"Content-Length").c_str(), nullptr, 10);
+        g_FetchCounters.transferredBytes += contentLength > 0 ? contentLength : decodedBytes;
+        g_FetchCounters.decodedBytes += decodedBytes;
+    }
+    else {
+        ++g_FetchCounters.truncated;
+    }
+
+    if (token.IsCancelled()) {
+        return TitleStore();
+    }
+
+    if (complete && statusCode == 200 && !trends.Empty()) {
+        validators.etag = response->Header(L"ETag");
+        validators.lastModified = response->Header(L"Last-Modified");
+    }
+    return trends;
+}
+
+/*
+* Worker Pool
+*/
+
+// Bounded pool shared by every parent in the process. Each task names a source key and
+// a limit; at most that many tasks with the key run at once and the rest wait in FIFO
+// order, so a Chrome profile is never read twice concurrently and fetches are capped.
+// Threads only hold the shared state, and each one also holds a reference on this module
+// that it drops as it exits, so a thread that outlives Shutdown keeps the plugin mapped
+// until it finishes instead of running unloaded code after Rainmeter frees the library.
+class WorkerPool {
+public:
+    struct Stats {
+        size_t threads;
+        size_t busy;
+        size_t queued;
+        uint64_t completed;
+
+        Stats() : threads(0), busy(0), queued(0), completed(0) {}
+    };
+
+    explicit WorkerPool(size_t threadCount) : state(std::make_shared<State>()) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        for (size_t i = 0; i < threadCount; ++i) {
+            // Taken here rather than by the thread, so it is held before the thread can run
+            HMODULE module = nullptr;
+            if (!GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, reinterpret_cast<LPCWSTR>(&WorkerEntry), &module)) {
+                break;
+            }
+
+            WorkerStart* start = new WorkerStart(state, module);
+            HANDLE thread = CreateThread(nullptr, 0, WorkerEntry, start, 0, nullptr);
+            if (!thread) {
+                delete start;
+                FreeLibrary(module);
+                break;
+            }
+            CloseHandle(thread);
+            ++state->threads;
+        }
+    }
+
+    ~WorkerPool() {
+        Shutdown(std::chrono::milliseconds(0));
+    }
+
+    void Submit(const std::wstring& sourceKey, size_t sourceLimit, std::function<void()> run) {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->queue.push_back(Task(sourceKey, std::max<size_t>(1, sourceLimit), std::move(run)));
+        }
+        state->wake.notify_one();
+    }
+
+    // Lets the threads finish every queued task, then waits up to timeout for them to exit.
+    // Returns false if some thread is still running when the wait ends.
+    bool Shutdown(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->stopping = true;
+        state->wake.notify_all();
+        return state->exited.wait_for(lock, timeout, [this]() { return state->threads == 0; });
+    }
+
+    Stats GetStats() const {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        Stats stats;
+        stats.threads = state->threads;
+        stats.busy = state->busy;
+        stats.queued = state->queue.size();
+        stats.completed = state->completed;
+        return stats;
+    }
+
+private:
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    struct Task {
+        std::wstring sourceKey;
+        size_t sourceLimit;
+        std::function<void()> run;
+
+        Task(const std::wstring& key, size_t limit, std::function<void()>&& task)
+            : sourceKey(key), sourceLimit(limit), run(std::move(task)) {}
+    };
+
+    struct State {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable exited;
+        std::deque<Task> queue;
+        std::unordered_map<std::wstring, size_t> running;  // Running tasks per source key
+        size_t threads;
+        size_t busy;
+        uint64_t completed;
+        bool stopping;
+
+        State() : threads(0), busy(0), completed(0), stopping(false) {}
+
+        // Oldest queued task whose source is below its limit; called with mutex held
+        std::deque<Task>::iterator FindRunnable() {
+            for (std::deque<Task>::iterator iter = queue.begin(); iter != queue.end(); ++iter) {
+                std::unordered_map<std::wstring, size_t>::const_iterator count = running.find(iter->sourceKey);
+                if (count == running.end() || count->second < iter->sourceLimit) {
+                    return iter;
+                }
+            }
+            return queue.end();
+        }
+    };
+
+    struct WorkerStart {
+        std::shared_ptr<State> state;
+        HMODULE module;
+
+        WorkerStart(const std::shared_ptr<State>& poolState, HMODULE pinnedModule) : state(poolState), module(pinnedModule) {}
+    };
+
+    // Everything the thread owns is destroyed before it releases the module and exits,
+    // since FreeLibraryAndExitThread may unmap the code that called it
+    static DWORD WINAPI WorkerEntry(LPVOID parameter) {
+        HMODULE module = static_cast<WorkerStart*>(parameter)->module;
+        {
+            std::unique_ptr<WorkerStart> start(static_cast<WorkerStart*>(parameter));
+            WorkerMain(std::move(start->state));
+        }
+        FreeLibraryAndExitThread(module, 0);
+        return 0;
+    }
+
+    static void WorkerMain(std::shared_ptr<State> state) {
+        // Lowers CPU, disk and memory priority so loads never compete with the foreground
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        for (;;) {
+            std::deque<Task>::iterator next = state->queue.end();
+            state->wake.wait(lock, [&]() {
+                next = state->FindRunnable();
+                return next != state->queue.end() || (state->stopping && state->queue.empty());
+            });
+            if (next == state->queue.end()) {
+                break;
+            }
+
+            Task task = std::move(*next);
+            state->queue.erase(next);
+            ++state->running[task.sourceKey];
+            ++state->busy;
+            lock.unlock();
+
+            task.run();
+            task.run = nullptr;  // Drop captured references before taking the lock again
+
+            lock.lock();
+            if (--state->running[task.sourceKey] == 0) {
+                state->running.erase(task.sourceKey);
+            }
+            --state->busy;
+            ++state->completed;
+            state->wake.notify_all();
+        }
+
+        --state->threads;
+        state->exited.notify_all();
+    }
+
+    std::shared_ptr<State> state;
+};
+
+/*
+* Refresh Scheduler
+*/
+
+// Intrusive wheel entry; the owner keeps it for as long as it may be scheduled
+struct TimerEntry {
+    TimerEntry* prev;
+    TimerEntry* next;
+    size_t slot;     // kUnscheduled when not in the wheel
+    size_t rounds;   // Full turns of the wheel left before it fires
+    void (*callback)(void* context);
+    void* context;
+
+    static const size_t kUnscheduled = SIZE_MAX;
+
+    TimerEntry(void (*timerCallback)(void*), void* timerContext)
+        : prev(nullptr), next(nullptr), slot(kUnscheduled), rounds(0), callback(timerCallback), context(timerContext) {}
+};
+
+// Hashed timer wheel: scheduling, cancelling and each tick's bookkeeping per entry are O(1).
+// Delays longer than one turn wait out their remaining rounds in the same slot.
+class TimerWheel {
+public:
+    static const size_t kSlots = 256;
+
+    TimerWheel() : current(0), count(0) {
+        std::fill(std::begin(slots), std::end(slots), nullptr);
+    }
+
+    // Fires entry after the given number of ticks (at least one), replacing any earlier schedule
+    void Schedule(TimerEntry& entry, size_t ticks) {
+        Cancel(entry);
+        ticks = std::max<size_t>(1, ticks);
+
+        entry.slot = (current + ticks) % kSlots;
+        entry.rounds = (ticks - 1) / kSlots;
+        entry.prev = nullptr;
+        entry.next = slots[entry.slot];
+        if (entry.next) {
+            entry.next->prev = &entry;
+        }
+        slots[entry.slot] = &entry;
+        ++count;
+    }
+
+    void Cancel(TimerEntry& entry) {
+        if (entry.slot == TimerEntry::kUnscheduled) {
+            return;
+        }
+        if (entry.prev) {
+            entry.prev->next = entry.next;
+        }
+        else {
+            slots[entry.slot] = entry.next;
+        }
+        if (entry.next) {
+            entry.next->prev = entry.prev;
+        }
+        entry.prev = entry.next = nullptr;
+        entry.slot = TimerEntry::kUnscheduled;
+        --count;
+    }
+
+    // Advances one tick. Due entries are unscheduled before their callbacks run,
+    // so a callback may schedule its own entry again.
+    void Tick() {
+        current = (current + 1) % kSlots;
+
+        TimerEntry* due = nullptr;
+        for (TimerEntry* entry = slots[current]; entry;) {
+            TimerEntry* next = entry->next;
+            if (entry->rounds > 0) {
+                --entry->rounds;
+            }
+            else {
+                Cancel(*entry);
+                entry->next = due;
+                due = entry;
+            }
+            entry = next;
+        }
+
+        while (due) {
+            TimerEntry* entry = due;
+            due = entry->next;
+            entry->next = nullptr;
+            entry->callback(entry->context);
+        }
+    }
+
+    bool Empty() const { return count == 0; }
+
+private:
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    TimerEntry* slots[kSlots];
+    size_t current;
+    size_t count;
+};
+
+// One wheel for every parent, ticked once per second by a thread timer on the skin
+// thread, so callbacks run where Reload and Update run
+TimerWheel g_RefreshWheel;
+UINT_PTR g_RefreshTimerId = 0;
+std::chrono::steady_clock::time_point g_NextRefreshTick;
+const std::chrono::seconds kRefreshTick(1);
+
+void CALLBACK RefreshTimerProc(HWND, UINT, UINT_PTR, DWORD) {
+    // WM_TIMER can arrive late or be coalesced; catch up on the ticks that were missed
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (g_NextRefreshTick <= now) {
+        g_NextRefreshTick += kRefreshTick;
+        g_RefreshWheel.Tick();
+    }
+}
+
+void StartRefreshTimer() {
+    if (g_RefreshTimerId == 0) {
+        g_NextRefreshTick = std::chrono::steady_clock::now() + kRefreshTick;
+        g_RefreshTimerId = SetTimer(nullptr, 0, static_cast<UINT>(std::chrono::milliseconds(kRefreshTick).count()), RefreshTimerProc);
     }
+}
 
-    int wideStrLen = MultiByteToWideChar(CP_UTF8, 0, utf8Str.c_str(), -1, nullptr, 0);
-    if (wideStrLen == 0) {
-        return std::wstring();
+void StopRefreshTimer() {
+    if (g_RefreshTimerId != 0) {
+        KillTimer(nullptr, g_RefreshTimerId);
+        g_RefreshTimerId = 0;
     }
+}
 
-    std::wstring wideStr(wideStrLen - 1, 0);
-    MultiByteToWideChar(CP_UTF8, 0, utf8Str.c_str(), -1, &wideStr[0], wideStrLen);
-    return wideStr;
+// Spreads an interval by up to 10% either way so skins loaded together drift apart
+size_t JitteredTicks(int seconds) {
+    static std::minstd_rand random(static_cast<unsigned>(std::chrono::steady_clock::now().time_since_epoch().count()));
+    size_t ticks = static_cast<size_t>(seconds);
+    size_t spread = ticks / 10;
+    return ticks - spread + random() % (2 * spread + 1);
 }
 
 /*
-* Copy Chrome DB File
+* Shared Data Sources
 */
 
-std::wstring CopyChromeHistoryToTemp(const std::wstring& profile) {
-    wchar_t tempPath[MAX_PATH];
-    GetTempPathW(MAX_PATH, tempPath);
+struct ParentMeasure;
 
-    std::wstring tempFolder = tempPath;
-    std::wstring chromeHistorySource = L"%LOCALAPPDATA%\\Google\\Chrome\\User Data\\" + profile + L"\\History";
-    std::wstring chromeHistoryTarget = tempFolder + L"History_Copy.db";
+// Options a load depends on, normalized by ReadLoadConfig. Equal configs share one source.
+struct LoadConfig {
+    std::wstring type;
+    std::wstring countryCode;
+    std::wstring profile;
+    int maxItems;
 
-    wchar_t resolvedPath[MAX_PATH];
-    ExpandEnvironmentStringsW(chromeHistorySource.c_str(), resolvedPath, MAX_PATH);
+    LoadConfig() : type(L""), countryCode(L"US"), profile(L"Default"), maxItems(0) {}
 
-    if (std::filesystem::exists(resolvedPath)) {
-        try {
-            std::filesystem::copy(resolvedPath, chromeHistoryTarget, std::filesystem::copy_options::overwrite_existing);
-            return chromeHistoryTarget;
-        }
-        catch (const std::exception& e) {
-            OutputDebugStringA(e.what());
-        }
+    bool SameSource(const LoadConfig& other) const {
+        return type == other.type && countryCode == other.countryCode &&
+               profile == other.profile && maxItems == other.maxItems;
     }
-    else {
-        OutputDebugStringW(L"Chrome History file not found.");
+
+    // Hash of the fields SameSource compares; equal configs give equal fingerprints
+    uint64_t Fingerprint() const {
+        const uint64_t parts[] = {
+            HashBytes(type.data(), type.size() * sizeof(wchar_t)),
+            HashBytes(countryCode.data(), countryCode.size() * sizeof(wchar_t)),
+            HashBytes(profile.data(), profile.size() * sizeof(wchar_t)),
+            static_cast<uint64_t>(maxItems)
+        };
+        return HashBytes(parts, sizeof(parts));
+    }
+};
+
+struct LoadConfigHash {
+    size_t operator()(const LoadConfig& config) const {
+        return static_cast<size_t>(config.Fingerprint());
+    }
+};
+
+struct LoadConfigEqual {
+    bool operator()(const LoadConfig& left, const LoadConfig& right) const {
+        return left.SameSource(right);
+    }
+};
+
+// Carried from one load to the next; only the load holding DataSource::loadMutex touches it
+struct LoadState {
+    std::shared_ptr<const ResultSnapshot> results;   // Newest results built, published or not
+    HistoryImage historyImage;
+    HistoryChangeProbe historyProbe;
+    sqlite3* historySource;
+    FeedValidators feedValidators;                    // Validators of the feed behind results
+
+    LoadState() : historySource(nullptr) {}
+
+    ~LoadState() {
+        sqlite3_close(historySource);
+    }
+};
+
+void RefreshTimerFired(void* context);
+
+// One loader and one published snapshot per distinct configuration, shared by every
+// parent subscribed to it. Owned through std::shared_ptr by g_DataSources and by every
+// running load, so a source released while a load winds down is freed by that load.
+struct DataSource : std::enable_shared_from_this<DataSource> {
+    const LoadConfig config;
+    std::vector<ParentMeasure*> subscribers;          // Skin thread only
+    int refreshInterval;                              // Shortest subscriber RefreshInterval, 0 to disable
+    TimerEntry refreshTimer;                          // Entry in g_RefreshWheel
+
+    std::shared_ptr<const ResultSnapshot> snapshot;  // Only accessed through std::atomic_load/atomic_store
+    std::atomic<uint64_t> snapshotVersion;            // Version of snapshot, 0 when there is none
+
+    // Guards currentLoad, generation, loadingCount changes and publishing; never held during I/O
+    std::mutex publishMutex;
+    std::condition_variable loadsDone;
+    std::shared_ptr<LoadToken> currentLoad;
+    uint64_t generation;
+
+    // Held by a load for its whole run, so loads of one source never overlap
+    std::mutex loadMutex;
+    LoadState loadState;
+
+    std::atomic<int> loadingCount;
+    std::atomic<bool> dataReady;
+
+    explicit DataSource(const LoadConfig& sourceConfig)
+        : config(sourceConfig), refreshInterval(0), refreshTimer(RefreshTimerFired, this),
+          snapshotVersion(0), generation(0), loadingCount(0), dataReady(false) {}
+};
+
+std::unordered_map<LoadConfig, std::shared_ptr<DataSource>, LoadConfigHash, LoadConfigEqual> g_DataSources;
+
+// Snapshot versions are unique across sources, so a child whose parent switched
+// source never mistakes the new snapshot for the one it pinned
+std::atomic<uint64_t> g_SnapshotVersion(0);
+
+// Created by the first load and shut down with the last parent; only used on the skin thread
+std::unique_ptr<WorkerPool> g_WorkerPool;
+const size_t kWorkerThreads = 4;
+const size_t kMaxNetworkFetches = 2;
+
+// How long Finalize waits for a cancelled load to reach a checkpoint
+const std::chrono::milliseconds kFinalizeTimeout(2000);
+
+WorkerPool& GetWorkerPool() {
+    if (!g_WorkerPool) {
+        g_WorkerPool = std::make_unique<WorkerPool>(kWorkerThreads);
     }
+    return *g_WorkerPool;
+}
 
-    return L"";
+// Sets up the state a new source's loads start from
+void InitLoadState(LoadState& state, const LoadConfig& config) {
+    if (config.type == L"Chrome_History") {
+        std::wstring historyPath = GetChromeHistoryPath(config.profile);
+        std::wstring historyFolder = std::filesystem::path(historyPath).parent_path().wstring();
+        state.historyProbe.Reset(historyPath, std::make_unique<DirectoryChangeWatcher>(historyFolder));
+    }
 }
 
-/*
-* Parse Chrome History
-*/
+// Makes the newest results visible, unless a newer load was started in the meantime
+void PublishResults(DataSource& source, const LoadToken& token) {
+    std::lock_guard<std::mutex> lock(source.publishMutex);
+    const std::shared_ptr<const ResultSnapshot>& results = source.loadState.results;
+    if (token.IsCancelled() || token.generation != source.generation || !results) {
+        return;
+    }
 
-std::vector<std::wstring> GetLastHistoryTitles(const std::wstring& dbPath) {
-    std::vector<std::wstring> historyTitles;
-    std::set<std::wstring> seenTitles;
+    if (results->version != source.snapshotVersion.load(std::memory_order_relaxed)) {
+        std::atomic_store(&source.snapshot, results);
+        source.snapshotVersion.store(results->version, std::memory_order_release);
+        source.dataReady = true;
+    }
+}
 
-    sqlite3* db = nullptr;
-    sqlite3_stmt* stmt = nullptr;
-    std::string query = "SELECT title FROM urls ORDER BY last_visit_time DESC";
-
-    if (sqlite3_open16(dbPath.c_str(), &db) == SQLITE_OK) {
-        if (sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
-            while (sqlite3_step(stmt) == SQLITE_ROW) {
-                const unsigned char* title = sqlite3_column_text(stmt, 0);
-                if (title) {
-                    std::string utf8Title(reinterpret_cast<const char*>(title));
-                    std::wstring wideTitle = Utf8ToWide(utf8Title);
-
-                    if (seenTitles.find(wideTitle) == seenTitles.end()) {
-                        historyTitles.push_back(wideTitle);
-                        seenTitles.insert(wideTitle);
-                    }
+// Runs with loadMutex held. Results of a load that completes after being superseded are
+// still kept in the state, since the probe already moved past them.
+void RunLoad(DataSource& source, const LoadToken& token, LoadLog& log) {
+    const LoadConfig& config = source.config;
+    LoadState& state = source.loadState;
+    TitleStore tempResults;
+    bool replaceResults = false;  // Set when a history query replaces results, even with nothing
+
+    if (config.type == L"Chrome_History") {
+        // Keep the current results and skip the whole pipeline if Chrome wrote nothing
+        if (state.historyProbe.HasChanged(state.historySource)) {
+            sqlite3* db = OpenChromeHistorySnapshot(config.profile, state.historyImage, state.historySource, token, log);
+            if (db) {
+                bool succeeded = GetLastHistoryTitles(db, config.maxItems, token, tempResults);
+                sqlite3_close(db);
+
+                // Only a successful query becomes the new baseline; a failed one is retried next time
+                if (succeeded) {
+                    state.historyProbe.Commit();
+                    replaceResults = state.results != nullptr;
                 }
-                else {
-                    std::wstring noTitle = L"(No Title)";
-                    if (seenTitles.find(noTitle) == seenTitles.end()) {
-                        historyTitles.push_back(noTitle);
-                        seenTitles.insert(noTitle);
-                    }
+                else if (!token.IsCancelled()) {
+                    log.Add(LOG_ERROR, L"Could not read Chrome history titles.");
                 }
             }
-            sqlite3_finalize(stmt);
+            else if (!token.IsCancelled()) {
+                log.Add(LOG_ERROR, L"Could not snapshot Chrome history database.");
+            }
+        }
+    }
+    else if (config.type == L"Top_Trends") {
+        std::wstring trendsUrl = L"https://trends.google.com/trending/rss?geo=" + config.countryCode;
+        std::shared_ptr<HttpTransport> transport = GetHttpTransport();
+        bool notModified = false;
+        tempResults = GetTopTrends(*transport, trendsUrl, config.maxItems, state.feedValidators, notModified, token);
+        if (notModified) {
+            log.Add(LOG_DEBUG, L"Trends feed not modified, keeping the current results.");
         }
-        sqlite3_close(db);
     }
 
-    return historyTitles;
+    // Build a new immutable snapshot - only if we got new data, or cleared history emptied it
+    if (!tempResults.Empty() || replaceResults) {
+        state.results = std::make_shared<const ResultSnapshot>(++g_SnapshotVersion, std::move(tempResults));
+    }
+
+    PublishResults(source, token);
 }
 
-/*
-*  Fetch Top Searches
-*/
+// Completed loads waiting for the skin thread, which drains them on WM_MSB_LOADCOMPLETE
+struct LoadCompletion {
+    std::weak_ptr<DataSource> source;
+    std::chrono::steady_clock::time_point finished;
+    LoadLog log;
+};
 
-std::vector<std::wstring> GetTopTrends(const std::wstring& url) {
-    std::vector<std::wstring> trends;
+const UINT WM_MSB_LOADCOMPLETE = WM_APP + 1;
+std::atomic<HWND> g_NotifyWindow(nullptr);
+std::mutex g_CompletionMutex;
+std::vector<LoadCompletion> g_Completions;
 
-    HINTERNET hInternet = InternetOpenW(L"RainmeterPlugin", INTERNET_OPEN_TYPE_PRECONFIG, nullptr, nullptr, 0);
-    if (hInternet) {
-        HINTERNET hConnect = InternetOpenUrlW(hInternet, url.c_str(), nullptr, 0, INTERNET_FLAG_RELOAD, 0);
-        if (hConnect) {
-            char buffer[1024];
-            DWORD bytesRead;
-            std::stringstream rssStream;
-
-            while (InternetReadFile(hConnect, buffer, sizeof(buffer), &bytesRead) && bytesRead > 0) {
-                rssStream.write(buffer, bytesRead);
-            }
-            InternetCloseHandle(hConnect);
-
-            std::string rssContent = rssStream.str();
-            size_t itemPos = 0;
-            bool firstTitle = true; // Skip the first <title> tag (feed URL)
-            
-            while ((itemPos = rssContent.find("<title>", itemPos)) != std::string::npos) {
-                size_t start = itemPos + 7;
-                size_t end = rssContent.find("</title>", start);
-                if (end != std::string::npos) {
-                    std::string utf8Title = rssContent.substr(start, end - start);
-
-                    // Skip first title and filter out unwanted entries
-                    if (!firstTitle && 
-                        utf8Title.find("http") == std::string::npos &&
-                        utf8Title.find("trends.google.com") == std::string::npos &&
-                        utf8Title.find("Daily Search Trends") == std::string::npos &&
-                        utf8Title.find("Google Trends") == std::string::npos &&
-                        !utf8Title.empty()) {
-                        trends.push_back(Utf8ToWide(utf8Title));
-                    }
-                    
-                    firstTitle = false;
-                    itemPos = end;
-                }
-                else {
-                    break;
-                }
-            }
+// Called by workers. Only the first completion of a batch posts a message; the rest
+// ride along when the skin thread drains the queue.
+void PostLoadComplete(const std::shared_ptr<DataSource>& source, LoadLog&& log) {
+    HWND window = g_NotifyWindow.load();
+    if (!window) {
+        return;
+    }
+
+    bool post = false;
+    {
+        std::lock_guard<std::mutex> lock(g_CompletionMutex);
+        post = g_Completions.empty();
+        g_Completions.push_back(LoadCompletion{ source, std::chrono::steady_clock::now(), std::move(log) });
+    }
+    if (post) {
+        PostMessageW(window, WM_MSB_LOADCOMPLETE, 0, 0);
+    }
+}
+
+void LoadDataAsync(std::shared_ptr<DataSource> source, std::shared_ptr<LoadToken> token) {
+    bool completed = false;
+    LoadLog log;
+    {
+        // A load superseded while waiting for the previous one never starts
+        std::lock_guard<std::mutex> loadLock(source->loadMutex);
+        if (!token->IsCancelled()) {
+            RunLoad(*source, *token, log);
+            completed = !token->IsCancelled();
         }
-        InternetCloseHandle(hInternet);
     }
 
-    return trends;
+    {
+        std::lock_guard<std::mutex> lock(source->publishMutex);
+        --source->loadingCount;
+    }
+    source->loadsDone.notify_all();
+
+    if (completed) {
+        PostLoadComplete(source, std::move(log));
+    }
+}
+
+// Arms the source's next scheduled load, counted from now
+void ScheduleRefresh(DataSource* source) {
+    if (source->refreshInterval > 0 && !source->config.type.empty()) {
+        g_RefreshWheel.Schedule(source->refreshTimer, JitteredTicks(source->refreshInterval));
+        StartRefreshTimer();
+    }
+    else {
+        g_RefreshWheel.Cancel(source->refreshTimer);
+    }
+}
+
+// Cancels the running load without waiting for it and queues a new one
+void StartLoad(DataSource* source) {
+    std::shared_ptr<LoadToken> token;
+    {
+        std::lock_guard<std::mutex> lock(source->publishMutex);
+        if (source->currentLoad) {
+            source->currentLoad->Cancel();
+        }
+        source->currentLoad = std::make_shared<LoadToken>(++source->generation);
+        token = source->currentLoad;
+
+        if (source->config.type.empty()) {
+            return;
+        }
+        ++source->loadingCount;
+    }
+
+    ScheduleRefresh(source);
+
+    // Loads of one Chrome profile run one at a time; all network fetches share one cap
+    std::wstring sourceKey = L"Network";
+    size_t sourceLimit = kMaxNetworkFetches;
+    if (source->config.type == L"Chrome_History") {
+        sourceKey = L"History:" + source->config.profile;
+        sourceLimit = 1;
+    }
+
+    std::shared_ptr<DataSource> owner = source->shared_from_this();
+    GetWorkerPool().Submit(sourceKey, sourceLimit, [owner, token]() {
+        LoadDataAsync(owner, token);
+    });
+}
+
+// Cancels the running load; with a timeout, also waits that long for it to return
+void CancelLoad(DataSource* source, std::chrono::milliseconds timeout) {
+    g_RefreshWheel.Cancel(source->refreshTimer);
+
+    std::unique_lock<std::mutex> lock(source->publishMutex);
+    if (source->currentLoad) {
+        source->currentLoad->Cancel();
+    }
+    source->loadsDone.wait_for(lock, timeout, [source]() { return source->loadingCount == 0; });
 }
 
 /*
@@ -160,72 +2541,326 @@ std::vector<std::wstring> GetTopTrends(const std::wstring& url) {
 
 struct ChildMeasure;
 
+// Identifies a parent: the skin plus the measure name folded to lower case, since
+// Rainmeter treats measure names case-insensitively
+struct ParentKey {
+    void* skin;
+    std::wstring name;
+
+    ParentKey() : skin(nullptr) {}
+
+    ParentKey(void* measureSkin, LPCWSTR measureName) : skin(measureSkin), name(measureName) {
+        if (!name.empty()) {
+            CharLowerBuffW(&name[0], static_cast<DWORD>(name.size()));
+        }
+    }
+
+    bool operator==(const ParentKey& other) const {
+        return skin == other.skin && name == other.name;
+    }
+};
+
+struct ParentKeyHash {
+    size_t operator()(const ParentKey& key) const {
+        const uint64_t parts[] = {
+            static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key.skin)),
+            HashBytes(key.name.data(), key.name.size() * sizeof(wchar_t))
+        };
+        return static_cast<size_t>(HashBytes(parts, sizeof(parts)));
+    }
+};
+
+// Per-measure options and bindings; loading and results live in the shared DataSource
 struct ParentMeasure {
     void* skin;
-    LPCWSTR name;
+    void* rm;
+    ParentKey key;
     ChildMeasure* ownerChild;
+    std::vector<ChildMeasure*> children;             // Bound children, not including ownerChild
 
-    std::wstring type;
-    std::wstring countryCode;
-    std::wstring profile;
+    LoadConfig config;
+    int refreshInterval;                              // Seconds between scheduled loads, 0 to disable
     std::wstring onCompleteAction;
-    std::vector<std::wstring> results;
-    
-    std::thread workerThread;
-    std::mutex dataMutex;
-    std::atomic<bool> isLoading;
-    std::atomic<bool> dataReady;
-    bool hasExecutedAction;
+    std::wstring onChangeAction;
+    std::shared_ptr<DataSource> source;               // Source for config, shared with equal parents
+    std::shared_ptr<const ResultSnapshot> notifiedSnapshot;  // Snapshot the actions last ran for
 
-    ParentMeasure() : skin(nullptr), name(nullptr), ownerChild(nullptr),
-                      type(L""), countryCode(L"US"), profile(L"Default"), 
-                      onCompleteAction(L""), isLoading(false), 
-                      dataReady(false), hasExecutedAction(false) {}
-    
-    ~ParentMeasure() {
-        if (workerThread.joinable()) {
-            workerThread.join();
-        }
-    }
+    ParentMeasure() : skin(nullptr), rm(nullptr), ownerChild(nullptr), refreshInterval(0),
+                      onCompleteAction(L""), onChangeAction(L"") {}
 };
 
 struct ChildMeasure {
     int index;
     ParentMeasure* parent;
+    ParentKey parentKey;       // Parent this child binds to; unset for parent measures
+    void* rm;
+    bool reportedUnbound;
 
-    ChildMeasure() : index(1), parent(nullptr) {}
+    // The snapshot GetString last resolved against; holding it keeps value valid
+    std::shared_ptr<const ResultSnapshot> pinnedSnapshot;
+    uint64_t pinnedVersion;
+    int pinnedIndex;
+    LPCWSTR value;
+    std::wstring diagnostics;  // Backs the pointer returned by WorkerStats() and FetchStats()
+
+    ChildMeasure() : index(1), parent(nullptr), rm(nullptr), reportedUnbound(false),
+                     pinnedVersion(0), pinnedIndex(0), value(L"") {}
 };
 
-std::vector<ParentMeasure*> g_ParentMeasures;
+std::unordered_map<ParentKey, std::unique_ptr<ParentMeasure>, ParentKeyHash> g_ParentMeasures;
+
+// Children waiting for a parent that is not initialized yet (or was finalized before them)
+std::unordered_map<ParentKey, std::vector<ChildMeasure*>, ParentKeyHash> g_PendingChildren;
+
+// Default RefreshInterval in seconds; Chrome history changes far more often than trends
+const int kHistoryRefreshInterval = 60;
+const int kTrendsRefreshInterval = 15 * 60;
+
+// Reads the options a load depends on. Options the type ignores are cleared, so
+// changing them does not count as a different configuration.
+LoadConfig ReadLoadConfig(void* rm) {
+    LoadConfig config;
+    config.type = RmReadString(rm, L"Type", L"");
+    config.countryCode = RmReadString(rm, L"CountryCode", L"US");
+    config.profile = RmReadString(rm, L"Profile", L"Default");
+    config.maxItems = (std::max)(0, RmReadInt(rm, L"MaxItems", 0));
+
+    if (config.type != L"Top_Trends") {
+        config.countryCode.clear();
+    }
+    if (config.type != L"Chrome_History") {
+        config.profile.clear();
+    }
+    return config;
+}
 
-void LoadDataAsync(ParentMeasure* parent, void* rm) {
-    parent->isLoading = true;
-    std::vector<std::wstring> tempResults;
+int ReadRefreshInterval(void* rm, const LoadConfig& config) {
+    int defaultInterval = config.type == L"Top_Trends" ? kTrendsRefreshInterval : kHistoryRefreshInterval;
+    return (std::max)(0, RmReadInt(rm, L"RefreshInterval", defaultInterval));
+}
 
-    if (parent->type == L"Chrome_History") {
-        std::wstring dbPath = CopyChromeHistoryToTemp(parent->profile);
-        if (!dbPath.empty()) {
-            tempResults = GetLastHistoryTitles(dbPath);
+// A shared source refreshes as often as its most demanding subscriber asks
+void UpdateRefreshInterval(DataSource* source) {
+    int refreshInterval = 0;
+    for (ParentMeasure* subscriber : source->subscribers) {
+        if (subscriber->refreshInterval > 0 && (refreshInterval == 0 || subscriber->refreshInterval < refreshInterval)) {
+            refreshInterval = subscriber->refreshInterval;
         }
-        else {
-            if (rm) RmLog(rm, LOG_ERROR, L"Could not copy Chrome history database.");
+    }
+
+    if (refreshInterval != source->refreshInterval) {
+        source->refreshInterval = refreshInterval;
+        ScheduleRefresh(source);
+    }
+}
+
+// Attaches the parent to the source for its config, creating and loading that source
+// if no other parent uses it yet
+void Subscribe(ParentMeasure* parent) {
+    std::shared_ptr<DataSource>& source = g_DataSources[parent->config];
+    bool created = !source;
+    if (created) {
+        source = std::make_shared<DataSource>(parent->config);
+        InitLoadState(source->loadState, source->config);
+    }
+
+    parent->source = source;
+    source->subscribers.push_back(parent);
+    UpdateRefreshInterval(source.get());
+
+    if (created) {
+        StartLoad(source.get());
+    }
+}
+
+// Detaches the parent from its source. The last subscriber stops the source, waiting
+// up to timeout for a running load to reach a checkpoint.
+void Unsubscribe(ParentMeasure* parent, std::chrono::milliseconds timeout) {
+    std::shared_ptr<DataSource> source = std::move(parent->source);
+    if (!source) {
+        return;
+    }
+
+    std::vector<ParentMeasure*>& subscribers = source->subscribers;
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), parent), subscribers.end());
+    if (!subscribers.empty()) {
+        UpdateRefreshInterval(source.get());
+        return;
+    }
+
+    CancelLoad(source.get(), timeout);
+    g_DataSources.erase(source->config);
+}
+
+// Scheduled load of a source. A load that is still queued or running absorbs it; the
+// schedule is simply pushed back by one interval.
+void RefreshTimerFired(void* context) {
+    DataSource* source = static_cast<DataSource*>(context);
+    if (source->loadingCount > 0) {
+        ScheduleRefresh(source);
+        return;
+    }
+
+    StartLoad(source);
+}
+
+// 1-based indices whose title differs between two snapshots, comma separated.
+// Every index of current is listed when there is no previous snapshot.
+std::wstring GetChangedIndices(const ResultSnapshot* previous, const ResultSnapshot& current) {
+    const std::vector<uint64_t> none;
+    const std::vector<uint64_t>& oldHashes = previous ? previous->itemHashes : none;
+    const std::vector<uint64_t>& newHashes = current.itemHashes;
+
+    const size_t count = (std::max)(oldHashes.size(), newHashes.size());
+
+    std::wstring indices;
+    for (size_t i = 0; i < count; ++i) {
+        if (i >= oldHashes.size() || i >= newHashes.size() || oldHashes[i] != newHashes[i]) {
+            if (!indices.empty()) {
+                indices += L',';
+            }
+            indices += std::to_wstring(i + 1);
+        }
+    }
+    return indices;
+}
+
+// Runs OnChangeAction and OnCompleteAction when the source published titles that differ
+// from the ones the actions last ran for; a reload that found nothing new stays silent.
+// Called from Update and, without waiting for it, on load completion.
+void RunChangeActions(ParentMeasure* parent) {
+    std::shared_ptr<const ResultSnapshot> current = std::atomic_load(&parent->source->snapshot);
+    if (!current || current == parent->notifiedSnapshot) {
+        return;
+    }
+
+    std::shared_ptr<const ResultSnapshot> previous = std::move(parent->notifiedSnapshot);
+    parent->notifiedSnapshot = current;
+    if (previous && previous->contentHash == current->contentHash) {
+        return;
+    }
+
+    if (!parent->onChangeAction.empty()) {
+        static const std::wstring placeholder = L"$ChangedIndices$";
+        std::wstring action = parent->onChangeAction;
+        std::wstring indices = GetChangedIndices(previous.get(), *current);
+        for (size_t pos = action.find(placeholder); pos != std::wstring::npos; pos = action.find(placeholder, pos + indices.size())) {
+            action.replace(pos, placeholder.size(), indices);
         }
+        RmExecute(parent->skin, action.c_str());
+    }
+
+    if (!parent->onCompleteAction.empty()) {
+        RmExecute(parent->skin, parent->onCompleteAction.c_str());
     }
-    else if (parent->type == L"Top_Trends") {
-        std::wstring trendsUrl = L"https://trends.google.com/trending/rss?geo=" + parent->countryCode;
-        tempResults = GetTopTrends(trendsUrl);
+}
+
+// Message-only window owned by the skin thread. Workers post to it, so completed loads
+// reach OnCompleteAction right away instead of on the next Update tick.
+LRESULT CALLBACK NotifyWindowProc(HWND window, UINT message, WPARAM wParam, LPARAM lParam) {
+    if (message != WM_MSB_LOADCOMPLETE) {
+        return DefWindowProcW(window, message, wParam, lParam);
     }
 
-    // Thread-safe update - only update if we got new data
+    std::vector<LoadCompletion> completions;
     {
-        std::lock_guard<std::mutex> lock(parent->dataMutex);
-        if (!tempResults.empty()) {
-            parent->results = tempResults;
-            parent->dataReady = true;
+        std::lock_guard<std::mutex> lock(g_CompletionMutex);
+        completions.swap(g_Completions);
+    }
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (const LoadCompletion& completion : completions) {
+        std::shared_ptr<DataSource> source = completion.source.lock();
+        if (!source || source->subscribers.empty()) {
+            continue;
+        }
+
+        // Only subscribers are known to be alive, so log through one of them before any
+        // action gets a chance to finalize it
+        void* rm = source->subscribers.front()->rm;
+        completion.log.Replay(rm);
+
+        long long latency = static_cast<long long>(std::chrono::duration_cast<std::chrono::microseconds>(
+            now - completion.finished).count());
+        RmLogF(rm, LOG_DEBUG, L"Load completion dispatched to %llu parent(s) %lld us after it finished",
+               static_cast<unsigned long long>(source->subscribers.size()), latency);
+
+        // A bang run by one action can reload a parent and move it to another source, so
+        // walk a copy and skip parents that left this one in the meantime
+        std::vector<ParentMeasure*> subscribers = source->subscribers;
+        for (ParentMeasure* subscriber : subscribers) {
+            const std::vector<ParentMeasure*>& current = source->subscribers;
+            if (std::find(current.begin(), current.end(), subscriber) != current.end()) {
+                RunChangeActions(subscriber);
+            }
         }
     }
-    
-    parent->isLoading = false;
+    return 0;
+}
+
+const wchar_t kNotifyWindowClass[] = L"ModernSearchBarNotify";
+
+HINSTANCE GetPluginInstance() {
+    HMODULE module = nullptr;
+    GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                       reinterpret_cast<LPCWSTR>(&NotifyWindowProc), &module);
+    return module;
+}
+
+// Without the window, Update still runs OnCompleteAction on its next tick
+void CreateNotifyWindow() {
+    if (g_NotifyWindow.load()) {
+        return;
+    }
+
+    WNDCLASSEXW windowClass = {};
+    windowClass.cbSize = sizeof(windowClass);
+    windowClass.lpfnWndProc = NotifyWindowProc;
+    windowClass.hInstance = GetPluginInstance();
+    windowClass.lpszClassName = kNotifyWindowClass;
+    RegisterClassExW(&windowClass);
+
+    g_NotifyWindow = CreateWindowExW(0, kNotifyWindowClass, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, windowClass.hInstance, nullptr);
+}
+
+// The class must be gone before the DLL unloads, since it points at NotifyWindowProc
+void DestroyNotifyWindow() {
+    HWND window = g_NotifyWindow.exchange(nullptr);
+    if (window) {
+        DestroyWindow(window);
+        UnregisterClassW(kNotifyWindowClass, GetPluginInstance());
+    }
+
+    std::lock_guard<std::mutex> lock(g_CompletionMutex);
+    g_Completions.clear();
+}
+
+void BindChild(ChildMeasure* child, ParentMeasure* parent) {
+    child->parent = parent;
+    parent->children.push_back(child);
+}
+
+// Detaches a child from its parent, or from the pending list if it is still waiting
+void UnbindChild(ChildMeasure* child) {
+    std::vector<ChildMeasure*>* list = nullptr;
+    std::unordered_map<ParentKey, std::vector<ChildMeasure*>, ParentKeyHash>::iterator pending = g_PendingChildren.end();
+
+    if (child->parent) {
+        list = &child->parent->children;
+    }
+    else {
+        pending = g_PendingChildren.find(child->parentKey);
+        if (pending == g_PendingChildren.end()) {
+            return;
+        }
+        list = &pending->second;
+    }
+
+    list->erase(std::remove(list->begin(), list->end(), child), list->end());
+    if (pending != g_PendingChildren.end() && list->empty()) {
+        g_PendingChildren.erase(pending);
+    }
+    child->parent = nullptr;
 }
 
 PLUGIN_EXPORT void Initialize(void** data, void* rm) {
@@ -233,37 +2868,49 @@ PLUGIN_EXPORT void Initialize(void** data, void* rm) {
     *data = child;
 
     void* skin = RmGetSkin(rm);
+    child->rm = rm;
 
     LPCWSTR parentName = RmReadString(rm, L"ParentName", L"");
     if (!*parentName) {
         // This is a parent measure
-        child->parent = new ParentMeasure;
-        child->parent->name = RmGetMeasureName(rm);
+        CreateNotifyWindow();
+        std::unique_ptr<ParentMeasure> parent = std::make_unique<ParentMeasure>();
+        child->parent = parent.get();
+        child->parent->key = ParentKey(skin, RmGetMeasureName(rm));
         child->parent->skin = skin;
+        child->parent->rm = rm;
         child->parent->ownerChild = child;
-        g_ParentMeasures.push_back(child->parent);
+        g_ParentMeasures[child->parent->key] = std::move(parent);
+
+        // Attach children that were initialized before this parent
+        std::unordered_map<ParentKey, std::vector<ChildMeasure*>, ParentKeyHash>::iterator pending =
+            g_PendingChildren.find(child->parent->key);
+        if (pending != g_PendingChildren.end()) {
+            for (ChildMeasure* waiting : pending->second) {
+                BindChild(waiting, child->parent);
+            }
+            g_PendingChildren.erase(pending);
+        }
 
-        child->parent->type = RmReadString(rm, L"Type", L"");
-        child->parent->countryCode = RmReadString(rm, L"CountryCode", L"US");
-        child->parent->profile = RmReadString(rm, L"Profile", L"Default");
+        child->parent->config = ReadLoadConfig(rm);
+        child->parent->refreshInterval = ReadRefreshInterval(rm, child->parent->config);
         child->parent->onCompleteAction = RmReadString(rm, L"OnCompleteAction", L"", FALSE);
+        child->parent->onChangeAction = RmReadString(rm, L"OnChangeAction", L"", FALSE);
 
-        // Start async loading
-        if (!child->parent->type.empty()) {
-            child->parent->workerThread = std::thread(LoadDataAsync, child->parent, rm);
-        }
+        // Share or start async loading
+        Subscribe(child->parent);
     }
     else {
-        // This is a child measure - find parent using name AND skin handle
-        std::vector<ParentMeasure*>::const_iterator iter = g_ParentMeasures.begin();
-        for (; iter != g_ParentMeasures.end(); ++iter) {
-            if (_wcsicmp((*iter)->name, parentName) == 0 && (*iter)->skin == skin) {
-                child->parent = (*iter);
-                return;
-            }
+        // This is a child measure - find parent using name AND skin handle, or wait for it
+        child->parentKey = ParentKey(skin, parentName);
+        std::unordered_map<ParentKey, std::unique_ptr<ParentMeasure>, ParentKeyHash>::const_iterator iter =
+            g_ParentMeasures.find(child->parentKey);
+        if (iter != g_ParentMeasures.end()) {
+            BindChild(child, iter->second.get());
+        }
+        else {
+            g_PendingChildren[child->parentKey].push_back(child);
         }
-
-        RmLog(rm, LOG_ERROR, L"Invalid \"ParentName\"");
     }
 }
 
@@ -271,32 +2918,39 @@ PLUGIN_EXPORT void Reload(void* data, void* rm, double* maxValue) {
     ChildMeasure* child = (ChildMeasure*)data;
     ParentMeasure* parent = child->parent;
 
+    // Read child-specific options, also while still waiting for the parent
+    child->index = static_cast<int>(RmReadInt(rm, L"Index", 1));
+
     if (!parent) {
         return;
     }
 
-    // Read child-specific options
-    child->index = static_cast<int>(RmReadInt(rm, L"Index", 1));
-
     // Read parent-specific options (only for owner child)
     if (parent->ownerChild == child) {
-        // Wait for previous thread to finish
-        if (parent->workerThread.joinable()) {
-            parent->workerThread.join();
-        }
-
-        parent->type = RmReadString(rm, L"Type", L"");
-        parent->countryCode = RmReadString(rm, L"CountryCode", L"US");
-        parent->profile = RmReadString(rm, L"Profile", L"Default");
+        LoadConfig config = ReadLoadConfig(rm);
+        int refreshInterval = ReadRefreshInterval(rm, config);
         parent->onCompleteAction = RmReadString(rm, L"OnCompleteAction", L"", FALSE);
+        parent->onChangeAction = RmReadString(rm, L"OnChangeAction", L"", FALSE);
 
-        // Reset action flag (keep cached data and dataReady status)
-        parent->hasExecutedAction = false;
+        // With DynamicVariables=1 this runs on every update; an unchanged configuration
+        // is left to the refresh scheduler
+        bool sourceChanged = !config.SameSource(parent->config);
+        bool intervalChanged = refreshInterval != parent->refreshInterval;
+        parent->refreshInterval = refreshInterval;
 
-        // Start async loading
-        if (!parent->type.empty()) {
-            parent->workerThread = std::thread(LoadDataAsync, parent, rm);
+        if (!sourceChanged) {
+            if (intervalChanged) {
+                UpdateRefreshInterval(parent->source.get());
+            }
+            return;
         }
+
+        // Move to the source for the new configuration; the old one is cancelled, not
+        // waited for, if nobody else uses it
+        Unsubscribe(parent, std::chrono::milliseconds(0));
+        parent->config = config;
+
+        Subscribe(parent);
     }
 }
 
@@ -305,58 +2959,65 @@ PLUGIN_EXPORT double Update(void* data) {
     ParentMeasure* parent = child->parent;
     
     if (!parent) {
+        // Every measure of the skin is initialized before the first update, so a child
+        // still waiting here names a parent that does not exist
+        if (!child->reportedUnbound) {
+            RmLog(child->rm, LOG_ERROR, L"Invalid \"ParentName\"");
+            child->reportedUnbound = true;
+        }
         return 0.0;
     }
     
-    // Check if data is ready and execute action once (only for owner child)
+    // Catch a change the notify window has not delivered yet (only for owner child)
     if (parent->ownerChild == child) {
-        if (parent->dataReady && !parent->hasExecutedAction) {
-            if (!parent->onCompleteAction.empty()) {
-                RmExecute(parent->skin, parent->onCompleteAction.c_str());
-                parent->hasExecutedAction = true;
-            }
-        }
+        RunChangeActions(parent);
     }
     
-    return parent->isLoading ? 1.0 : 0.0;
+    return parent->source->loadingCount > 0 ? 1.0 : 0.0;
 }
 
 PLUGIN_EXPORT LPCWSTR GetString(void* data) {
     ChildMeasure* child = (ChildMeasure*)data;
     ParentMeasure* parent = child->parent;
 
-    static std::wstring result;
-    result.clear();
-
     if (!parent) {
-        result = L"Error: No parent measure";
-        return result.c_str();
+        return L"Error: No parent measure";
+    }
+
+    DataSource* source = parent->source.get();
+
+    // Nothing was published and Index did not change: hand back the same pointer
+    uint64_t version = source->snapshotVersion.load(std::memory_order_acquire);
+    if (version != 0 && version == child->pinnedVersion && child->index == child->pinnedIndex) {
+        return child->value;
     }
 
-    // Thread-safe read
-    std::lock_guard<std::mutex> lock(parent->dataMutex);
+    // Pin the current snapshot; never blocks on a running load
+    child->pinnedSnapshot = std::atomic_load(&source->snapshot);
+    const ResultSnapshot* snapshot = child->pinnedSnapshot.get();
     
     // Always return cached data if available (even while loading new data)
-    if (!parent->results.empty()) {
-        if (child->index > 0 && child->index <= static_cast<int>(parent->results.size())) {
-            result = parent->results[child->index - 1];
+    if (snapshot && !snapshot->titles.Empty()) {
+        child->pinnedVersion = snapshot->version;
+        child->pinnedIndex = child->index;
+        if (child->index > 0 && child->index <= static_cast<int>(snapshot->titles.Size())) {
+            child->value = snapshot->titles.GetWide(child->index - 1);
         }
         else {
-            result = L"";
+            child->value = L"";
         }
+        return child->value;
     }
+
     // Only show loading states when no cached data is available
-    else if (parent->isLoading) {
-        result = L"Loading...";
-    }
-    else if (parent->dataReady) {
-        result = L"No data found.";
+    child->pinnedVersion = 0;
+    if (source->loadingCount > 0) {
+        return L"Loading...";
     }
-    else {
-        result = L"Initializing...";
+    else if (source->dataReady) {
+        return L"No data found.";
     }
-
-    return result.c_str();
+    return L"Initializing...";
 }
 
 PLUGIN_EXPORT void Finalize(void* data) {
@@ -364,16 +3025,65 @@ PLUGIN_EXPORT void Finalize(void* data) {
     ParentMeasure* parent = child->parent;
 
     if (parent && parent->ownerChild == child) {
-        // Wait for worker thread to complete before cleanup
-        if (parent->workerThread.joinable()) {
-            parent->workerThread.join();
+        // If no other parent shares the source, its load is cancelled and given a bounded
+        // time to reach a checkpoint. A load that takes longer frees the source itself.
+        Unsubscribe(parent, kFinalizeTimeout);
+
+        // Children finalized later must not reach the freed parent; they wait for a
+        // parent of the same name again
+        for (ChildMeasure* bound : parent->children) {
+            bound->parent = nullptr;
+            g_PendingChildren[parent->key].push_back(bound);
         }
+        parent->children.clear();
+
+        // Copy the key: erasing destroys the parent that holds it
+        ParentKey key = parent->key;
+        g_ParentMeasures.erase(key);
 
-        g_ParentMeasures.erase(
-            std::remove(g_ParentMeasures.begin(), g_ParentMeasures.end(), parent),
-            g_ParentMeasures.end());
-        delete parent;
+        // Queued loads were all cancelled above, so the threads drain quickly
+        if (g_ParentMeasures.empty()) {
+            StopRefreshTimer();
+            DestroyNotifyWindow();
+            if (g_WorkerPool) {
+                g_WorkerPool->Shutdown(kFinalizeTimeout);
+                g_WorkerPool.reset();
+            }
+            ReleaseHttpTransport();
+        }
+    }
+    else {
+        UnbindChild(child);
     }
 
     delete child;
 }
+
+// Section variable for diagnostics, e.g. [&MeasureParent:WorkerStats()]
+PLUGIN_EXPORT LPCWSTR WorkerStats(void* data, const int argc, const WCHAR* argv[]) {
+    ChildMeasure* child = (ChildMeasure*)data;
+    WorkerPool::Stats stats = g_WorkerPool ? g_WorkerPool->GetStats() : WorkerPool::Stats();
+
+    wchar_t buffer[128];
+    swprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), L"threads=%llu busy=%llu queued=%llu completed=%llu",
+             static_cast<unsigned long long>(stats.threads), static_cast<unsigned long long>(stats.busy),
+             static_cast<unsigned long long>(stats.queued), static_cast<unsigned long long>(stats.completed));
+    child->diagnostics = buffer;
+    return child->diagnostics.c_str();
+}
+
+// Section variable for diagnostics, e.g. [&MeasureParent:FetchStats()]
+PLUGIN_EXPORT LPCWSTR FetchStats(void* data, const int argc, const WCHAR* argv[]) {
+    ChildMeasure* child = (ChildMeasure*)data;
+
+    wchar_t buffer[192];
+    swprintf(buffer, sizeof(buffer) / sizeof(buffer[0]), L"fetches=%llu notmodified=%llu compressed=%llu truncated=%llu transferred=%llu decoded=%llu",
+             static_cast<unsigned long long>(g_FetchCounters.fetches.load()),
+             static_cast<unsigned long long>(g_FetchCounters.notModified.load()),
+             static_cast<unsigned long long>(g_FetchCounters.compressed.load()),
+             static_cast<unsigned long long>(g_FetchCounters.truncated.load()),
+             static_cast<unsigned long long>(g_FetchCounters.transferredBytes.load()),
+             static_cast<unsigned long long>(g_FetchCounters.decodedBytes.load()));
+    child->diagnostics = buffer;
+    return child->diagnostics.c_str();
+}